@@ -43,6 +43,7 @@ DiskRequestDone (int arg)
 SynchDisk::SynchDisk(char* name)
 {
     semaphore = new Semaphore("synch disk", 0);
+    semaphore->forIO = TRUE;
     lock = new Lock("synch disk lock");
     for( int i = 0 ; i < NumSectors ; i ++)
     {
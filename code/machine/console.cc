@@ -161,6 +161,8 @@ SynchConsole::SynchConsole(char *readFile, char *writeFile)
 	writeLock = new Lock("writeLock") ;
 	readAvail = new Semaphore("readavail", 0) ;
 	writeDone = new Semaphore("writedone", 0) ;
+	readAvail->forIO = TRUE ;
+	writeDone->forIO = TRUE ;
 	console = new Console(readFile, writeFile, ReadAvail, WriteDone, 0) ;
 } 
 
@@ -49,6 +49,230 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    seq = 0;
+    index = -1;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::EventQueue
+// 	Initialize an empty queue of pending interrupts.
+//----------------------------------------------------------------------
+
+EventQueue::EventQueue()
+{
+    size = 16;
+    heap = new PendingInterrupt *[size];
+    count = 0;
+    nextSeq = 0;
+    freeList = NULL;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::~EventQueue
+// 	De-allocate the queue, along with every interrupt still in it
+//	or in the pool.
+//----------------------------------------------------------------------
+
+EventQueue::~EventQueue()
+{
+    PendingInterrupt *event;
+
+    for (int i = 0; i < count; i++)
+	delete heap[i];
+    delete [] heap;
+    while (freeList != NULL) {
+	event = freeList;
+	freeList = event->next;
+	delete event;
+    }
+}
+
+//----------------------------------------------------------------------
+// EventQueue::NewEvent
+// 	Return an interrupt record initialized with the given values,
+//	reusing one that has already fired if possible.  It is not put
+//	in the queue yet.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+EventQueue::NewEvent(VoidFunctionPtr func, int param, int time, IntType kind)
+{
+    PendingInterrupt *event = freeList;
+
+    if (event == NULL)
+	return new PendingInterrupt(func, param, time, kind);
+    freeList = event->next;
+    event->handler = func;
+    event->arg = param;
+    event->when = time;
+    event->type = kind;
+    event->next = NULL;
+    return event;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::FreeEvent
+// 	Put an interrupt that is no longer in the queue back in the pool.
+//----------------------------------------------------------------------
+
+void
+EventQueue::FreeEvent(PendingInterrupt *event)
+{
+    event->next = freeList;
+    freeList = event;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Insert
+// 	Put an interrupt in the queue, growing the heap if need be.
+//	Interrupts scheduled for the same time fire in the order they
+//	were inserted.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Insert(PendingInterrupt *event)
+{
+    if (count == size) {
+	PendingInterrupt **bigger = new PendingInterrupt *[size * 2];
+
+	for (int i = 0; i < count; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    event->seq = nextSeq++;
+    Place(event, count);
+    SiftUp(count++);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::RemoveFirst
+// 	Take the next interrupt to fire off the queue, and return it.
+//	Returns NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+EventQueue::RemoveFirst()
+{
+    PendingInterrupt *first;
+
+    if (count == 0)
+	return NULL;
+    first = heap[0];
+    Place(heap[--count], 0);
+    if (count > 0)
+	SiftDown(0);
+    first->index = -1;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Remove
+// 	Take an interrupt that has not fired yet off the queue, wherever
+//	it is.  The last interrupt in the heap is moved into its slot,
+//	and then sifted whichever way it needs to go.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Remove(PendingInterrupt *event)
+{
+    int i = event->index;
+    PendingInterrupt *last;
+
+    ASSERT((i >= 0) && (i < count) && (heap[i] == event));
+    last = heap[--count];
+    if (i < count) {
+	Place(last, i);
+	SiftUp(i);
+	SiftDown(last->index);
+    }
+    event->index = -1;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Update
+// 	Move an interrupt to its new place in the queue, after its
+//	"when" has been changed.  It is ordered as if it had just been
+//	inserted, so it fires after any others due at the same time.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Update(PendingInterrupt *event)
+{
+    int i = event->index;
+
+    ASSERT((i >= 0) && (i < count) && (heap[i] == event));
+    event->seq = nextSeq++;
+    SiftUp(i);
+    SiftDown(event->index);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Mapcar
+// 	Apply "func" to every interrupt in the queue (for DumpState).
+//----------------------------------------------------------------------
+
+void
+EventQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (int i = 0; i < count; i++)
+	(*func)((int) heap[i]);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Before, Place, SiftUp, SiftDown
+// 	The usual binary heap operations.  "Before" defines the order:
+//	earlier "when" first, and among equal "when", earlier "seq".
+//	Every store into the heap goes through Place, to keep each
+//	interrupt's "index" up to date.
+//----------------------------------------------------------------------
+
+bool
+EventQueue::Before(PendingInterrupt *a, PendingInterrupt *b)
+{
+    return (a->when < b->when) || ((a->when == b->when) && (a->seq < b->seq));
+}
+
+void
+EventQueue::Place(PendingInterrupt *event, int i)
+{
+    heap[i] = event;
+    event->index = i;
+}
+
+void
+EventQueue::SiftUp(int i)
+{
+    PendingInterrupt *event = heap[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(event, heap[parent]))
+	    break;
+	Place(heap[parent], i);
+	i = parent;
+    }
+    Place(event, i);
+}
+
+void
+EventQueue::SiftDown(int i)
+{
+    PendingInterrupt *event = heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < count) {
+	if ((child + 1 < count) && Before(heap[child + 1], heap[child]))
+	    child++;
+	if (!Before(heap[child], event))
+	    break;
+	Place(heap[child], i);
+	i = child;
+    }
+    Place(event, i);
 }
 
 //----------------------------------------------------------------------
@@ -61,7 +285,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new EventQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -74,8 +298,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
     delete pending;
 }
 
@@ -179,6 +401,49 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how many user instructions can be executed before an 
+//	interrupt becomes due.  Nothing can happen during those
+//	instructions except the clock advancing (unless one of them traps
+//	to the kernel), so the machine can account for their time in one
+//	go with AdvanceUserTime, and only call OneTick for the instruction
+//	after them.
+//
+//	Never more than MaxTickBatch, and 0 if we are tracing interrupts,
+//	since OneTick then prints something on every tick.
+//----------------------------------------------------------------------
+
+int
+Interrupt::TicksUntilDue()
+{
+    PendingInterrupt *next = pending->First();
+    int count;
+
+    if (DebugIsEnabled('i'))
+	return 0;
+    if (next == NULL)
+	return MaxTickBatch;
+    count = (next->when - stats->totalTicks + UserTick - 1) / UserTick - 1;
+    if (count < 0)
+	return 0;
+    return (count < MaxTickBatch) ? count : MaxTickBatch;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTime
+// 	Advance simulated time by "count" user instructions, without
+//	checking for interrupts; the caller has made sure (with
+//	TicksUntilDue) that none can be due.
+//----------------------------------------------------------------------
+
+void
+Interrupt::AdvanceUserTime(int count)
+{
+    stats->totalTicks += count * UserTick;
+    stats->userTicks += count * UserTick;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -251,7 +516,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it in the event queue.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -261,12 +526,16 @@ Interrupt::Halt()
 //	"fromNow" is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	"type" is the hardware device that generated the interrupt
+//
+//	Returns a handle on the interrupt, which can be passed to Cancel
+//	or Reschedule.  The handle is only good until the interrupt
+//	fires or is canceled: after that, the record is reused.
 //----------------------------------------------------------------------
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = pending->NewEvent(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
@@ -274,7 +543,45 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 	//				intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur);
+    return toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+// 	Take an interrupt that has not fired yet out of the queue, so
+//	that it never fires.  This replaces scheduling it anyway and
+//	having the handler check whether it still matters.
+//
+//	"toCancel" is the handle returned by Schedule
+//----------------------------------------------------------------------
+
+void
+Interrupt::Cancel(PendingInterrupt *toCancel)
+{
+    DEBUG('i', "Canceling interrupt handler the %s at time = %d\n", 
+				intTypeNames[toCancel->type], toCancel->when);
+    pending->Remove(toCancel);
+    pending->FreeEvent(toCancel);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Reschedule
+// 	Move an interrupt that has not fired yet to "now + fromNow",
+//	which can be earlier or later than it was going to fire.
+//
+//	"toMove" is the handle returned by Schedule
+//	"fromNow" is how far in the future it is now to occur
+//----------------------------------------------------------------------
+
+void
+Interrupt::Reschedule(PendingInterrupt *toMove, int fromNow)
+{
+    ASSERT(fromNow > 0);
+    toMove->when = stats->totalTicks + fromNow;
+    DEBUG('i', "Rescheduling interrupt handler the %s at time = %d\n", 
+				intTypeNames[toMove->type], toMove->when);
+    pending->Update(toMove);
 }
 
 //----------------------------------------------------------------------
@@ -300,24 +607,24 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending->First();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {	// not time yet
 	return FALSE;
     }
+    pending->RemoveFirst();
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
 				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+	 pending->Insert(toOccur);
 	 return FALSE;
     }
 
@@ -334,7 +641,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    pending->FreeEvent(toOccur);
     return TRUE;
 }
 
@@ -52,6 +52,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
 				NetworkSendInt, NetworkRecvInt};
 
+// The most user instructions the machine will run between calls to
+// OneTick, even if no interrupt is due (see TicksUntilDue).
+#define MaxTickBatch	1000
+
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
@@ -67,6 +71,58 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int seq;			// Order in which it was scheduled, so that
+				// interrupts due at the same time fire
+				// first-come, first-served
+    int index;			// Where it is in the heap, or -1 once it
+				// has fired or been canceled
+    PendingInterrupt *next;	// Link on the free list, once it has fired
+};
+
+// The following class defines the queue of interrupts scheduled to occur:
+// a binary heap ordered by (when, seq), so that scheduling an interrupt 
+// is O(log n) and finding the next one to fire is O(1).  Fired
+// interrupts are kept on a free list and reused, rather than going back
+// to the heap allocator each time.
+//
+// Each interrupt remembers its position in the heap, so one that has
+// not fired yet can be taken out, or moved to a new time, in O(log n)
+// without searching for it.
+
+class EventQueue {
+  public:
+    EventQueue();			// initialize an empty queue
+    ~EventQueue();			// de-allocate the queue
+
+    PendingInterrupt *NewEvent(VoidFunctionPtr func, int param, int time,
+				IntType kind);
+    					// get an interrupt from the pool
+    void FreeEvent(PendingInterrupt *event);
+					// put a fired interrupt back in the pool
+    void Insert(PendingInterrupt *event); // put an interrupt in the queue
+    PendingInterrupt *First() { return (count == 0) ? NULL : heap[0]; }
+					// the next interrupt to fire, if any
+    PendingInterrupt *RemoveFirst();	// take it off the queue
+    void Remove(PendingInterrupt *event); // take any interrupt off the queue
+    void Update(PendingInterrupt *event); // restore heap order after
+					// changing "event->when"
+    bool IsEmpty() { return (count == 0); }
+    void Mapcar(VoidFunctionPtr func);	// apply "func" to every interrupt,
+					// in no particular order
+
+  private:
+    bool Before(PendingInterrupt *a, PendingInterrupt *b);
+					// should "a" fire before "b"?
+    void SiftUp(int i);			// restore heap order around heap[i]
+    void SiftDown(int i);
+    void Place(PendingInterrupt *event, int i); // heap[i] = event
+
+    PendingInterrupt **heap;	// heap[0] is the next to fire; the
+				// children of heap[i] are heap[2i+1, 2i+2]
+    int count;			// number of interrupts in the heap
+    int size;			// number of slots allocated in "heap"
+    int nextSeq;		// seq of the next interrupt scheduled
+    PendingInterrupt *freeList;	// fired interrupts, to be reused
 };
 
 // The following class defines the data structures for the simulation
@@ -106,11 +162,24 @@ class Interrupt {
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
-	int arg, int when, IntType type);// at time ``when''.  This is called
-    					// by the hardware device simulators.
+    PendingInterrupt *Schedule(VoidFunctionPtr handler,
+	int arg, int fromNow, IntType type);
+					// Schedule an interrupt to occur
+					// "fromNow" ticks from now.  This is
+					// called by the hardware device
+					// simulators.  The result can be
+					// passed to Cancel or Reschedule until
+					// the interrupt fires.
+    void Cancel(PendingInterrupt *toCancel);
+					// Forget a scheduled interrupt
+    void Reschedule(PendingInterrupt *toMove, int fromNow);
+					// Make it fire at a different time
     
     void OneTick();       		// Advance simulated time
+    int TicksUntilDue();		// How many user instructions can run
+					// before one of them must call OneTick
+    void AdvanceUserTime(int count);	// Account for "count" user 
+					// instructions at once
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
     									// to occur now
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
@@ -118,7 +187,7 @@ class Interrupt {
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
+    EventQueue *pending;	// the interrupts scheduled
 				// to occur in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
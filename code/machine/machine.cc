@@ -61,6 +61,21 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodeValid[i] = FALSE;
+    pendingTicks = tickBudget = 0;
+    registerOwner = NULL;
+    currentASID = 0;
+    useBlocks = FALSE;
+    blockCache = new BasicBlock *[MemorySize / 4];
+    blockCovered = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	blockCache[i] = NULL;
+	blockCovered[i] = FALSE;
+    }
+    blockEpoch = 0;
     
     //ڴ 
     memoryMap = new BitMap(NumPhysPages) ; 
@@ -72,10 +87,14 @@ Machine::Machine(bool debug)
 	}
       	
 //#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
+    tlb = NULL;
+    tlbNext = NULL;
+    tlbTree = NULL;
     TLBtime = 0 ;
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
+    for (i = 0; i < FastTLBSize; i++) {
+	readCache[i].virtualPage = writeCache[i].virtualPage = -1;
+	readCache[i].page = writeCache[i].page = NULL;
+    }
     //pageTable = NULL;
     
 /*    
@@ -85,6 +104,8 @@ Machine::Machine(bool debug)
 #endif
 */
 
+    ConfigureTLB(TLBSize, TLBSize, TLB_LRU);	// fully associative
+
     singleStep = debug;
     CheckEndian();
 }
@@ -97,8 +118,16 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    for (int i = 0; i < NumPhysPages; i++)
+	FlushBlocks(i);
+    delete [] blockCache;
+    delete [] blockCovered;
     if (tlb != NULL)
         delete [] tlb;
+    delete [] tlbNext;
+    delete [] tlbTree;
 }
 
 //----------------------------------------------------------------------
@@ -118,6 +147,7 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
+    SyncTicks();			// the kernel may look at the time
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
@@ -227,6 +257,36 @@ void Machine::WriteRegister(int num, int value)
 	registers[num] = value;
     }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+//	Throw away the pre-decoded instructions, translated blocks and
+//	fast translations cached for a physical page.  The kernel must
+//	call this whenever it changes the contents of a frame behind the
+//	simulator's back -- in particular, when a page is brought in on
+//	a page fault.  (Stores done by the user program itself are caught
+//	in WriteMem.)
+//
+//	"frame" -- the physical page number whose contents changed
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int frame)
+{
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    bool *valid = &decodeValid[frame * InstrsPerPage];
+    char *page = &mainMemory[frame * PageSize];
+
+    for (int i = 0; i < InstrsPerPage; i++)
+	valid[i] = FALSE;
+    FlushBlocks(frame);
+    for (int i = 0; i < FastTLBSize; i++) {
+	if (readCache[i].page == page)
+	    readCache[i].virtualPage = -1;
+	if (writeCache[i].page == page)
+	    writeCache[i].virtualPage = -1;
+    }
+}
+
 void Thread::Suspend ()
 {
 	printf("Suspend: %s\n", currentThread->getName()) ;
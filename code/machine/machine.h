@@ -26,6 +26,10 @@
 #include "translate.h"
 #include "disk.h"
 #include "../userprog/bitmap.h"
+
+class BasicBlock;
+class Thread;
+
 // Definitions related to the size, and format of user memory
 
 #define PageSize 	SectorSize 	// set the page size equal to
@@ -35,6 +39,10 @@
 #define NumPhysPages    32
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+					// (the default; see ConfigureTLB)
+#define InstrsPerPage	(PageSize / 4)	// instruction words per page frame
+#define FastTLBSize	64		// entries in readCache and writeCache;
+					// must be a power of 2
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -53,6 +61,15 @@ enum ExceptionType { NoException,           // Everything ok!
 		     NumExceptionTypes
 };
 
+// How the TLB miss handler chooses which entry of a set to replace,
+// when none of them is free (see Machine::TLBVictim).
+
+enum TLBPolicy { TLB_LRU,		// least recently used
+		 TLB_PLRU,		// tree pseudo-LRU: one bit per node
+		 TLB_RANDOM,
+		 TLB_FIFO		// oldest entry loaded
+};
+
 // User program CPU state.  The full set of MIPS registers, plus a few
 // more because we need to be able to start/stop a user program between
 // any two instructions (thus we need to keep track of things like load
@@ -123,17 +140,54 @@ class Machine {
 
 // Routines callable by the Nachos kernel
     void Run();	 		// Run a user program
+    void RunBlocks();		// Run it with the basic-block engine
+    void ClockTick();		// Advance time after a user instruction
+    void SyncTicks();		// Account for batched instruction ticks
 
     int ReadRegister(int num);	// read the contents of a CPU register
 
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void InvalidateDecodedPage(int frame);
+				// forget the pre-decoded instructions of
+				// a physical page, because the kernel has
+				// changed its contents (eg, paged it in)
+
+    void LoadTLB(int index, TranslationEntry *entry);
+				// put a translation into the TLB
+    void FlushTLB();		// invalidate the whole TLB
+    void FlushTLBFrame(int frame);
+				// invalidate the TLB entries, of any address
+				// space, that map to a physical page
+    void SetASID(int asid);	// switch to another address space
+    void ConfigureTLB(int size, int ways, TLBPolicy policy);
+				// replace the TLB with an empty one of
+				// "size" entries, in sets of "ways"
+    int TLBVictim(unsigned int vpn);
+				// which TLB slot a translation for "vpn"
+				// should be loaded into
+    void TouchTLB(int index);	// TLB slot "index" was just used
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
+    void OneInstruction(); 	
     				// Run one instruction of a user program.
+    Instruction *FetchInstruction(int pc);
+				// Translate "pc" and return its decoded
+				// instruction, decoding it only if it is
+				// not already cached.  Returns NULL if
+				// the fetch raised an exception.
+    Instruction *DecodedWord(int word);
+				// Decode the word at physical address
+				// word * 4, if it isn't already cached
+    BasicBlock *FindBlock(int pc, void **handlers);
+				// Return the translated block starting at
+				// "pc"; NULL if the fetch raised an exception
+    BasicBlock *TranslateBlock(int pc, int physAddr, void **handlers);
+				// Build the block starting at "pc"
+    void FlushBlocks(int frame);
+				// Discard the blocks in a physical page
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -143,6 +197,11 @@ class Machine {
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
     
+    void FillFastTLB(FastTLBEntry *cache, unsigned int vpn, int frame);
+    void FlushFastTLB(int vpn);
+				// Add to or remove from the host-side
+				// shortcuts for translations in the TLB
+    
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
@@ -172,7 +231,29 @@ class Machine {
     InvertedList * invertedList ;
 	
 	int registers[NumTotalRegs]; // CPU registers, for executing user programs
-
+    Thread *registerOwner;	// user thread whose registers these are, or
+				// NULL (see Thread::LoadUserState)
+
+    Instruction *decodeCache;	// pre-decoded copy of every instruction
+				// word in mainMemory, indexed by
+				// physical address / 4
+    bool *decodeValid;		// is the decodeCache slot up to date?
+				// Cleared by user stores to the word and
+				// by InvalidateDecodedPage
+
+    bool useBlocks;		// run user code with RunBlocks rather than
+				// one instruction at a time
+    BasicBlock **blockCache;	// translated block starting at each
+				// instruction word, or NULL
+    bool *blockCovered;		// is the word part of some cached block?
+    int blockEpoch;		// bumped whenever a cached block is
+				// discarded
+    int blockScratch;		// where block ops write register 0
+
+    int pendingTicks;		// user instructions run, but not yet
+				// added to the simulated time
+    int tickBudget;		// how many more instructions can run
+				// before calling OneTick (see ClockTick)
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -195,6 +276,23 @@ class Machine {
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
 
+    FastTLBEntry readCache[FastTLBSize];	// direct-mapped by vpn;
+    FastTLBEntry writeCache[FastTLBSize];	// see ReadMem, WriteMem
+    int currentASID;		// address space now running: only TLB
+				// entries tagged with it are used
+
+    int tlbSize;		// number of entries in "tlb"
+    int tlbWays;		// entries per set: a translation for vpn
+				// can only be in set (vpn & tlbSetMask),
+				// tlb[set * tlbWays .. set * tlbWays + 
+				// tlbWays - 1]
+    int tlbSetMask;		// number of sets - 1
+    TLBPolicy tlbPolicy;	// how to choose the entry to replace
+    int *tlbNext;		// for FIFO, the next entry to replace in
+				// each set
+    char *tlbTree;		// for PLRU, tlbWays bits for each set;
+				// bit 1 of a set is the root of its tree
+
     //TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
@@ -0,0 +1,631 @@
+// mipsblock.cc -- basic-block execution engine for the MIPS simulator
+//
+//   An alternative to the one-instruction-at-a-time loop in mipssim.cc.
+//   Straight-line runs of instructions are translated once into arrays
+//   of BlockOps (see mipsblock.h), and then run by jumping directly
+//   from the code for one op to the code for the next, using GCC's
+//   "labels as values" (computed goto) extension.
+//
+//   The architectural behavior is meant to be exactly that of
+//   OneInstruction, which is still used for single-stepping, for
+//   tracing (-d m), and for the rare instructions (syscalls, LWL, ...)
+//   the block engine doesn't handle itself; running the same program
+//   both ways is a good check on either one.  The only visible
+//   difference is that the instruction fetch is translated once per
+//   block, rather than once per instruction, so the TLB sees fewer
+//   references.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "mipsblock.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// BasicBlock::BasicBlock
+// 	Allocate a block of "numOps" instructions starting at virtual
+//	address "pc", plus the BLOCK_END op that terminates it.
+//----------------------------------------------------------------------
+
+BasicBlock::BasicBlock(int pc, int numOps)
+{
+    startPC = pc;
+    length = numOps;
+    ops = new BlockOp[numOps + 1];
+}
+
+BasicBlock::~BasicBlock()
+{
+    delete [] ops;
+}
+
+//----------------------------------------------------------------------
+// IsControl
+// 	Is "opCode" a branch or jump (ie, does it have a delay slot)?
+//----------------------------------------------------------------------
+
+static bool
+IsControl(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodedWord
+// 	Return the decoded instruction at physical word "word", decoding
+//	it into decodeCache if need be.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodedWord(int word)
+{
+    Instruction *instr = &decodeCache[word];
+
+    if (!decodeValid[word]) {
+	instr->value = WordToHost(*(unsigned int *) &mainMemory[word * 4]);
+	instr->Decode();
+	decodeValid[word] = TRUE;
+    }
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Build the block of instructions starting at virtual address "pc",
+//	whose physical address is "physAddr".
+//
+//	The block runs until the first branch or jump (including its
+//	delay slot), the first instruction we leave to OneInstruction,
+//	or the end of the page, whichever comes first.  A branch whose
+//	delay slot is on the next page, or is itself a branch, is left
+//	to OneInstruction as well.
+//
+//	"handlers" -- the dispatch table of Machine::RunBlocks, indexed
+//		by opcode (or BLOCK_xxx)
+//----------------------------------------------------------------------
+
+BasicBlock *
+Machine::TranslateBlock(int pc, int physAddr, void **handlers)
+{
+    int first = physAddr / 4;
+    int last = (physAddr / PageSize + 1) * InstrsPerPage;
+    int word, n, kind;
+    bool done = FALSE;
+    Instruction *instr;
+    Instruction *decoded[InstrsPerPage];
+    BasicBlock *block;
+    BlockOp *op;
+
+    // First find out how long the block is.
+    for (word = first, n = 0; word < last && !done; word++) {
+	instr = DecodedWord(word);
+	if (IsControl(instr->opCode)) {
+	    if ((word + 1 < last) && !IsControl(DecodedWord(word + 1)->opCode)) {
+		decoded[n++] = instr;
+		decoded[n++] = DecodedWord(word + 1);
+	    } else if (n == 0)
+		decoded[n++] = instr;	// becomes a BLOCK_LEGACY op
+	    done = TRUE;
+	} else {
+	    decoded[n++] = instr;
+	    done = (handlers[instr->opCode] == handlers[BLOCK_LEGACY]);
+	}
+    }
+
+    block = new BasicBlock(pc, n);
+    for (int i = 0; i < n; i++) {
+	instr = decoded[i];
+	op = &block->ops[i];
+	op->pc = pc + i * 4;
+	op->dst = &blockScratch;
+	op->src1 = op->src2 = &registers[0];
+	op->imm = instr->extra;
+	op->reg = instr->rt;
+	kind = instr->opCode;
+
+	switch (kind) {
+	  case OP_ADD: case OP_ADDU: case OP_AND: case OP_NOR: case OP_OR:
+	  case OP_SLT: case OP_SLTU: case OP_SUB: case OP_SUBU: case OP_XOR:
+	  case OP_MULT: case OP_MULTU: case OP_DIV: case OP_DIVU:
+	  case OP_BEQ: case OP_BNE:
+	  case OP_SB: case OP_SH: case OP_SW:
+	    if (instr->rd != 0)
+		op->dst = &registers[instr->rd];
+	    op->src1 = &registers[instr->rs];
+	    op->src2 = &registers[instr->rt];
+	    break;
+
+	  case OP_SLL: case OP_SRA: case OP_SRL:
+	  case OP_SLLV: case OP_SRAV: case OP_SRLV:
+	    if (instr->rd != 0)
+		op->dst = &registers[instr->rd];
+	    op->src1 = &registers[instr->rt];
+	    op->src2 = &registers[instr->rs];
+	    break;
+
+	  case OP_ANDI: case OP_ORI: case OP_XORI:
+	    op->imm = instr->extra & 0xffff;
+	    // fall through
+	  case OP_ADDI: case OP_ADDIU: case OP_SLTI: case OP_SLTIU:
+	    if (instr->rt != 0)
+		op->dst = &registers[instr->rt];
+	    op->src1 = &registers[instr->rs];
+	    break;
+
+	  case OP_LUI:			// run as "ORI rt,r0,imm"
+	    if (instr->rt != 0)
+		op->dst = &registers[instr->rt];
+	    op->imm = instr->extra << 16;
+	    break;
+
+	  case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+	    op->src1 = &registers[instr->rs];
+	    break;
+
+	  case OP_MFHI: case OP_MFLO:
+	    if (instr->rd != 0)
+		op->dst = &registers[instr->rd];
+	    op->src1 = &registers[(kind == OP_MFHI) ? HiReg : LoReg];
+	    break;
+
+	  case OP_MTHI: case OP_MTLO:
+	    op->dst = &registers[(kind == OP_MTHI) ? HiReg : LoReg];
+	    op->src1 = &registers[instr->rs];
+	    break;
+
+	  case OP_JALR:
+	    if (instr->rd != 0)
+		op->dst = &registers[instr->rd];
+	    // fall through
+	  case OP_JR:
+	    op->src1 = &registers[instr->rs];
+	    break;
+
+	  case OP_J: case OP_JAL:
+	    op->imm = ((op->pc + 8) & 0xf0000000) | IndexToAddr(instr->extra);
+	    break;
+
+	  case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+	  case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+	    op->src1 = &registers[instr->rs];
+	    break;
+	}
+	if (IsControl(kind) && (kind != OP_J) && (kind != OP_JAL))
+	    op->imm = op->pc + 4 + IndexToAddr(instr->extra);
+	if ((i == 0) && (n == 1) && IsControl(kind))
+	    kind = BLOCK_LEGACY;	// its delay slot couldn't be included
+	op->handler = handlers[kind];
+    }
+    block->ops[n].handler = handlers[BLOCK_END];
+    block->ops[n].pc = pc + n * 4;
+
+    for (word = first; word < first + n; word++)
+	blockCovered[word] = TRUE;
+    DEBUG('b', "Translated block at 0x%x, %d instructions\n", pc, n);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Return the block starting at virtual address "pc", translating
+//	it if it isn't already cached.  The fetch is translated like
+//	any other, so it may cause a TLB miss or page fault, in which
+//	case we return NULL (the exception has already been handled).
+//----------------------------------------------------------------------
+
+BasicBlock *
+Machine::FindBlock(int pc, void **handlers)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    BasicBlock *block;
+
+    exception = Translate(pc, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, pc);
+	return NULL;
+    }
+    block = blockCache[physicalAddress / 4];
+    if (block != NULL) {
+	if (block->startPC == pc)
+	    return block;
+	delete block;		// same frame, different virtual address
+	blockEpoch++;
+    }
+    block = TranslateBlock(pc, physicalAddress, handlers);
+    blockCache[physicalAddress / 4] = block;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushBlocks
+// 	Throw away every block in physical page "frame", because the
+//	contents of one of its words have changed.  Bumping blockEpoch
+//	tells any RunBlocks in the middle of one of these blocks (including
+//	those of threads that are switched out) to stop using it.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushBlocks(int frame)
+{
+    int first = frame * InstrsPerPage;
+    bool flushed = FALSE;
+
+    for (int word = first; word < first + InstrsPerPage; word++) {
+	if (blockCache[word] != NULL) {
+	    delete blockCache[word];
+	    blockCache[word] = NULL;
+	    flushed = TRUE;
+	}
+	blockCovered[word] = FALSE;
+    }
+    if (flushed)
+	blockEpoch++;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	The main loop of the block engine; called by Machine::Run when
+//	useBlocks is set.  Never returns.
+//
+//	Between any two instructions the simulated machine is in exactly
+//	the state OneInstruction would have left it in: the program
+//	counters are advanced, and delayed loads are done, after every op.
+//	Time is accounted as in Run (see Machine::ClockTick), and since a
+//	tick may switch threads (which may change the contents of memory),
+//	we check blockEpoch after each one before touching the current
+//	block again.
+//
+//	An op that traps to the kernel ends the block: the kernel may
+//	have changed the program counters, so we look up the next block
+//	from scratch.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    static void *handlers[NumBlockHandlers];
+    BasicBlock *block;
+    BlockOp *op;
+    int epoch, value, addr, target;
+    unsigned int urs, urt;
+    long long product;
+    bool loadPending;
+    int i = 0;
+
+    if (handlers[BLOCK_END] == NULL) {
+	for (int k = 0; k < NumBlockHandlers; k++)
+	    handlers[k] = &&do_legacy;
+	handlers[OP_ADD] = &&do_add;
+	handlers[OP_ADDI] = &&do_addi;
+	handlers[OP_ADDIU] = &&do_addiu;
+	handlers[OP_ADDU] = &&do_addu;
+	handlers[OP_AND] = &&do_and;
+	handlers[OP_ANDI] = &&do_andi;
+	handlers[OP_BEQ] = &&do_beq;
+	handlers[OP_BGEZ] = &&do_bgez;
+	handlers[OP_BGEZAL] = &&do_bgezal;
+	handlers[OP_BGTZ] = &&do_bgtz;
+	handlers[OP_BLEZ] = &&do_blez;
+	handlers[OP_BLTZ] = &&do_bltz;
+	handlers[OP_BLTZAL] = &&do_bltzal;
+	handlers[OP_BNE] = &&do_bne;
+	handlers[OP_DIV] = &&do_div;
+	handlers[OP_DIVU] = &&do_divu;
+	handlers[OP_J] = &&do_j;
+	handlers[OP_JAL] = &&do_jal;
+	handlers[OP_JALR] = &&do_jalr;
+	handlers[OP_JR] = &&do_jr;
+	handlers[OP_LB] = &&do_lb;
+	handlers[OP_LBU] = &&do_lbu;
+	handlers[OP_LH] = &&do_lh;
+	handlers[OP_LHU] = &&do_lhu;
+	handlers[OP_LW] = &&do_lw;
+	handlers[OP_MULT] = &&do_mult;
+	handlers[OP_MULTU] = &&do_multu;
+	handlers[OP_NOR] = &&do_nor;
+	handlers[OP_OR] = &&do_or;
+	handlers[OP_ORI] = &&do_ori;
+	handlers[OP_SB] = &&do_sb;
+	handlers[OP_SH] = &&do_sh;
+	handlers[OP_SLL] = &&do_sll;
+	handlers[OP_SLLV] = &&do_sllv;
+	handlers[OP_SLT] = &&do_slt;
+	handlers[OP_SLTI] = &&do_slti;
+	handlers[OP_SLTIU] = &&do_sltiu;
+	handlers[OP_SLTU] = &&do_sltu;
+	handlers[OP_SRA] = &&do_sra;
+	handlers[OP_SRAV] = &&do_srav;
+	handlers[OP_SRL] = &&do_srl;
+	handlers[OP_SRLV] = &&do_srlv;
+	handlers[OP_SUB] = &&do_sub;
+	handlers[OP_SUBU] = &&do_subu;
+	handlers[OP_SW] = &&do_sw;
+	handlers[OP_XOR] = &&do_xor;
+	handlers[OP_XORI] = &&do_xori;
+	handlers[OP_LUI] = &&do_ori;
+	handlers[OP_MFHI] = &&do_move;
+	handlers[OP_MFLO] = &&do_move;
+	handlers[OP_MTHI] = &&do_move;
+	handlers[OP_MTLO] = &&do_move;
+	handlers[BLOCK_END] = &&next_block;
+    }
+
+// The end of every op: finish the pending delayed load (if any),
+// advance the program counters, and tick the clock.
+
+#define DONE		goto done
+#define BRANCH(taken)	{ target = (taken) ? op->imm : op->pc + 8; goto branch; }
+#define TRAP		goto trapped
+
+  next_block:
+    // A block always starts outside a delay slot; if we stopped in
+    // one, let OneInstruction finish the branch.
+    if (registers[NextPCReg] != registers[PCReg] + 4) {
+	OneInstruction();
+	TRAP;
+    }
+    block = FindBlock(registers[PCReg], handlers);
+    if (block == NULL)
+	TRAP;
+    epoch = blockEpoch;
+    loadPending = (registers[LoadReg] != 0);
+    op = block->ops;
+    goto *op->handler;
+
+  do_add:
+    value = *op->src1 + *op->src2;
+    if (!((*op->src1 ^ *op->src2) & SIGN_BIT) &&
+	((*op->src1 ^ value) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	TRAP;
+    }
+    *op->dst = value;
+    DONE;
+
+  do_addi:
+    value = *op->src1 + op->imm;
+    if (!((*op->src1 ^ op->imm) & SIGN_BIT) &&
+	((op->imm ^ value) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	TRAP;
+    }
+    *op->dst = value;
+    DONE;
+
+  do_sub:
+    value = *op->src1 - *op->src2;
+    if (((*op->src1 ^ *op->src2) & SIGN_BIT) &&
+	((*op->src1 ^ value) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	TRAP;
+    }
+    *op->dst = value;
+    DONE;
+
+  do_addiu:	*op->dst = *op->src1 + op->imm;			DONE;
+  do_addu:	*op->dst = *op->src1 + *op->src2;		DONE;
+  do_subu:	*op->dst = *op->src1 - *op->src2;		DONE;
+  do_and:	*op->dst = *op->src1 & *op->src2;		DONE;
+  do_andi:	*op->dst = *op->src1 & op->imm;			DONE;
+  do_or:	*op->dst = *op->src1 | *op->src2;		DONE;
+  do_ori:	*op->dst = *op->src1 | op->imm;			DONE;
+  do_xor:	*op->dst = *op->src1 ^ *op->src2;		DONE;
+  do_xori:	*op->dst = *op->src1 ^ op->imm;			DONE;
+  do_nor:	*op->dst = ~(*op->src1 | *op->src2);		DONE;
+  do_slt:	*op->dst = (*op->src1 < *op->src2);		DONE;
+  do_slti:	*op->dst = (*op->src1 < op->imm);		DONE;
+  do_sltu:
+    *op->dst = ((unsigned int) *op->src1 < (unsigned int) *op->src2);
+    DONE;
+  do_sltiu:
+    *op->dst = ((unsigned int) *op->src1 < (unsigned int) op->imm);
+    DONE;
+  do_sll:	*op->dst = *op->src1 << op->imm;		DONE;
+  do_sllv:	*op->dst = *op->src1 << (*op->src2 & 0x1f);	DONE;
+  do_sra:	*op->dst = *op->src1 >> op->imm;		DONE;
+  do_srav:	*op->dst = *op->src1 >> (*op->src2 & 0x1f);	DONE;
+  do_srl:
+    *op->dst = (unsigned int) *op->src1 >> op->imm;
+    DONE;
+  do_srlv:
+    *op->dst = (unsigned int) *op->src1 >> (*op->src2 & 0x1f);
+    DONE;
+  do_move:	*op->dst = *op->src1;				DONE;
+
+  do_mult:
+    product = (long long) *op->src1 * (long long) *op->src2;
+    registers[HiReg] = (int) (product >> 32);
+    registers[LoReg] = (int) product;
+    DONE;
+
+  do_multu:
+    product = (long long) ((unsigned long long) (unsigned int) *op->src1 *
+			   (unsigned long long) (unsigned int) *op->src2);
+    registers[HiReg] = (int) (product >> 32);
+    registers[LoReg] = (int) product;
+    DONE;
+
+  do_div:
+    if (*op->src2 == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] = *op->src1 / *op->src2;
+	registers[HiReg] = *op->src1 % *op->src2;
+    }
+    DONE;
+
+  do_divu:
+    urs = (unsigned int) *op->src1;
+    urt = (unsigned int) *op->src2;
+    if (urt == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] = (int) (urs / urt);
+	registers[HiReg] = (int) (urs % urt);
+    }
+    DONE;
+
+  // Loads.  The loaded value replaces any pending delayed load.
+
+  do_lb:
+    if (!ReadMem(*op->src1 + op->imm, 1, &value))
+	TRAP;
+    value = (value & 0x80) ? (value | 0xffffff00) : (value & 0xff);
+    goto load;
+
+  do_lbu:
+    if (!ReadMem(*op->src1 + op->imm, 1, &value))
+	TRAP;
+    value &= 0xff;
+    goto load;
+
+  do_lh:
+    addr = *op->src1 + op->imm;
+    if (addr & 0x1) {
+	RaiseException(AddressErrorException, addr);
+	TRAP;
+    }
+    if (!ReadMem(addr, 2, &value))
+	TRAP;
+    value = (value & 0x8000) ? (value | 0xffff0000) : (value & 0xffff);
+    goto load;
+
+  do_lhu:
+    addr = *op->src1 + op->imm;
+    if (addr & 0x1) {
+	RaiseException(AddressErrorException, addr);
+	TRAP;
+    }
+    if (!ReadMem(addr, 2, &value))
+	TRAP;
+    value &= 0xffff;
+    goto load;
+
+  do_lw:
+    addr = *op->src1 + op->imm;
+    if (addr & 0x3) {
+	RaiseException(AddressErrorException, addr);
+	TRAP;
+    }
+    if (!ReadMem(addr, 4, &value))
+	TRAP;
+  load:
+    DelayedLoad(op->reg, value);
+    loadPending = TRUE;
+    goto advance;
+
+  // Stores.  The store may overwrite the block we are running, so
+  // don't look at "op" again until blockEpoch has been checked.
+
+  do_sb:
+    if (!WriteMem((unsigned) (*op->src1 + op->imm), 1, *op->src2))
+	TRAP;
+    DONE;
+
+  do_sh:
+    if (!WriteMem((unsigned) (*op->src1 + op->imm), 2, *op->src2))
+	TRAP;
+    DONE;
+
+  do_sw:
+    if (!WriteMem((unsigned) (*op->src1 + op->imm), 4, *op->src2))
+	TRAP;
+    DONE;
+
+  // Branches.  The link register is written before the condition
+  // is tested, as in OneInstruction.
+
+  do_beq:	BRANCH(*op->src1 == *op->src2);
+  do_bne:	BRANCH(*op->src1 != *op->src2);
+  do_bgtz:	BRANCH(*op->src1 > 0);
+  do_blez:	BRANCH(*op->src1 <= 0);
+  do_bgezal:
+    registers[R31] = op->pc + 8;
+  do_bgez:
+    BRANCH(!(*op->src1 & SIGN_BIT));
+  do_bltzal:
+    registers[R31] = op->pc + 8;
+  do_bltz:
+    BRANCH(*op->src1 & SIGN_BIT);
+  do_jal:
+    registers[R31] = op->pc + 8;
+  do_j:
+    BRANCH(TRUE);
+  do_jalr:
+    *op->dst = op->pc + 8;
+  do_jr:
+    target = *op->src1;
+    goto branch;
+
+  // Everything else is simulated by OneInstruction, which may trap;
+  // either way, it's the end of the block.
+
+  do_legacy:
+    OneInstruction();
+    TRAP;
+
+  branch:
+    if (loadPending) {
+	DelayedLoad(0, 0);
+	loadPending = FALSE;
+    }
+    registers[PrevPCReg] = op->pc;
+    registers[PCReg] = op->pc + 4;
+    registers[NextPCReg] = target;
+    goto tick;
+
+  done:
+    if (loadPending) {
+	DelayedLoad(0, 0);
+	loadPending = FALSE;
+    }
+  advance:
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = registers[PCReg] + 4;
+  tick:
+    if (tickBudget > 0) {
+	tickBudget--;
+	pendingTicks++;
+    } else
+	ClockTick();
+    if (++i % 20000000 == 0) {
+	SyncTicks();
+	currentThread->Suspend();
+    }
+    if (epoch != blockEpoch)
+	goto next_block;
+    op++;
+    goto *op->handler;
+
+  trapped:
+    if (tickBudget > 0) {
+	tickBudget--;
+	pendingTicks++;
+    } else
+	ClockTick();
+    if (++i % 20000000 == 0) {
+	SyncTicks();
+	currentThread->Suspend();
+    }
+    goto next_block;
+
+#undef DONE
+#undef BRANCH
+#undef TRAP
+}
@@ -0,0 +1,60 @@
+// mipsblock.h
+//	Data structures for the basic-block execution engine.
+//
+//	Instead of decoding and dispatching one instruction at a time
+//	through the big switch in OneInstruction, the block engine
+//	translates a straight-line run of MIPS instructions (ending
+//	at a branch plus its delay slot) into an array of BlockOps.
+//	Each BlockOp holds the address of the code that simulates it,
+//	and pointers to the registers it uses, so running a block is
+//	just a sequence of indirect jumps (see Machine::RunBlocks).
+//
+//	Blocks are cached by the physical address of their first
+//	instruction, and thrown away whenever any word they cover
+//	changes (see Machine::FlushBlocks).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MIPSBLOCK_H
+#define MIPSBLOCK_H
+
+#include "copyright.h"
+
+// Handlers that don't correspond to a MIPS opcode.  They are stored
+// in the dispatch table after the opcodes (see mipssim.h).
+
+#define BLOCK_LEGACY	(MaxOpcode + 1)	// run by OneInstruction
+#define BLOCK_END	(MaxOpcode + 2)	// fell off the end of the block
+#define NumBlockHandlers (MaxOpcode + 3)
+
+// One pre-decoded instruction of a block.  Register 0 is never written
+// through "dst": writes to it go to a scratch word instead, so the
+// handlers don't need to keep R0 zero.
+
+class BlockOp {
+  public:
+    void *handler;	// label in Machine::RunBlocks simulating this op
+    int *dst;		// register written by the op
+    int *src1;		// first source register (rs, or rt for shifts)
+    int *src2;		// second source register
+    int imm;		// immediate (already extended or masked), shift
+			// amount, or branch target
+    int reg;		// register # loaded by a load
+    int pc;		// virtual address of the instruction
+};
+
+// A translated straight-line run of instructions, all in one page.
+
+class BasicBlock {
+  public:
+    BasicBlock(int pc, int numOps);
+    ~BasicBlock();
+
+    int startPC;	// virtual address of the first instruction
+    int length;		// number of instructions covered
+    BlockOp *ops;	// "length" ops, followed by a BLOCK_END op
+};
+
+#endif // MIPSBLOCK_H
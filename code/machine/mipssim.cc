@@ -25,27 +25,79 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	If useBlocks is set, the program is run by the basic-block engine
+//	(mipsblock.cc) instead, unless we are single-stepping or tracing
+//	instructions, which only OneInstruction knows how to do.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
-	Instruction *instr = new Instruction;  // storage for decoded instruction
 	//printf("%s: %d\n", currentThread->getName(), currentThread->prior ) ;
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+    if (useBlocks && !singleStep && !DebugIsEnabled('m'))
+	RunBlocks();			// never returns
     int i ;
     for (i = 1; 1; i++ ) {
-        OneInstruction(instr);
-		interrupt->OneTick();
+        OneInstruction();
+		if (tickBudget > 0) {		// nothing can be due yet
+			tickBudget--;
+			pendingTicks++;
+		} else
+			ClockTick();
 		if (singleStep && (runUntilTime <= stats->totalTicks))
 	  		Debugger();
-		if( i % 20000000 == 0 ) currentThread->Suspend() ; 
+		if( i % 20000000 == 0 ) {
+			SyncTicks();
+			currentThread->Suspend() ; 
+		}
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::ClockTick
+// 	Advance simulated time after a user instruction, firing any
+//	interrupts that are due.
+//
+//	Calling interrupt->OneTick after every instruction is expensive,
+//	and almost always nothing is due, so after each real tick we ask
+//	how many instructions can follow before something will be
+//	(tickBudget).  Those instructions just count themselves in
+//	pendingTicks, which is added to the clock in one go before the
+//	next real tick, or before anything else can look at the time
+//	(see SyncTicks).  Simulated time comes out exactly the same.
+//----------------------------------------------------------------------
+
+void
+Machine::ClockTick()
+{
+    SyncTicks();
+    interrupt->OneTick();
+    tickBudget = singleStep ? 0 : interrupt->TicksUntilDue();
+}
+
+//----------------------------------------------------------------------
+// Machine::SyncTicks
+// 	Bring simulated time up to date with the instructions executed
+//	since the last real tick, and stop batching.  Called before
+//	the kernel gets control, since it may look at the time, schedule
+//	new interrupts, or switch threads.
+//----------------------------------------------------------------------
+
+void
+Machine::SyncTicks()
+{
+    if (pendingTicks > 0) {
+	interrupt->AdvanceUserTime(pendingTicks);
+	pendingTicks = 0;
+    }
+    tickBudget = 0;
+}
+
 
 //----------------------------------------------------------------------
 // TypeToReg
@@ -90,21 +142,23 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one exception is the decoded form of each instruction, which
+//	is cached by physical address (see FetchInstruction); the cache
+//	is kept coherent with every change to the contents of memory.
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction()
 {
-    int raw;
+    Instruction *instr;
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if ((instr = FetchInstruction(registers[PCReg])) == NULL)
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -375,7 +429,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
 	break;
 	
       case OP_ORI:
@@ -445,15 +499,15 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SRL:
-	tmp = registers[instr->rt];
-	tmp >>= instr->extra;
-	registers[instr->rd] = tmp;
+	rt = registers[instr->rt];
+	rt >>= instr->extra;
+	registers[instr->rd] = rt;
 	break;
 	
       case OP_SRLV:
-	tmp = registers[instr->rt];
-	tmp >>= (registers[instr->rs] & 0x1f);
-	registers[instr->rd] = tmp;
+	rt = registers[instr->rt];
+	rt >>= (registers[instr->rs] & 0x1f);
+	registers[instr->rd] = rt;
 	break;
 	
       case OP_SUB:	  
@@ -566,6 +620,47 @@ Machine::OneInstruction(Instruction *instr)
     registers[NextPCReg] = pcAfter;
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch and decode the instruction at virtual address "pc".
+//
+//	Decoding is by far the most expensive part of simulating an
+//	instruction, and user programs spend nearly all their time in
+//	loops, so the decoded form of each word is kept in decodeCache,
+//	indexed by its physical address.  The translation is still done
+//	on every fetch, so that the TLB (and its use bits) behave exactly
+//	as if the word had been read with ReadMem.
+//
+//	A slot is invalidated when the user program stores to that word
+//	(WriteMem), or when the kernel replaces the contents of the whole
+//	frame (InvalidateDecodedPage).
+//
+//	Returns NULL if the translation failed; the exception has already
+//	been raised in that case.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchInstruction(int pc)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    Instruction *instr;
+
+    exception = Translate(pc, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, pc);
+	return NULL;
+    }
+    instr = &decodeCache[physicalAddress / 4];
+    if (!decodeValid[physicalAddress / 4]) {
+	instr->value = WordToHost(*(unsigned int *)
+					&mainMemory[physicalAddress]);
+	instr->Decode();
+	decodeValid[physicalAddress / 4] = TRUE;
+    }
+    return instr;
+}
+
 //----------------------------------------------------------------------
 // Machine::DelayedLoad
 // 	Simulate effects of a delayed load.
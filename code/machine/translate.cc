@@ -79,6 +79,10 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
+//	An aligned access to a page that is in readCache skips Translate
+//	altogether; the TLB entry it came from is still marked as used,
+//	so the kernel sees the same use bits and LRU times either way.
+//
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
 //	"value" -- the place to write the result
@@ -90,27 +94,41 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    char *host;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    FastTLBEntry *fast = &readCache[vpn % FastTLBSize];
+
+    if ((fast->virtualPage == (int) vpn) && !(addr & (size - 1))) {
+	fast->entry->time = TLBtime++;
+	fast->entry->freq++;
+	fast->entry->use = TRUE;
+	if (tlbPolicy == TLB_PLRU)
+	    TouchTLB(fast->entry - tlb);
+	host = fast->page + (unsigned) addr % PageSize;
+    } else {
+	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
-    
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	FillFastTLB(readCache, vpn, physicalAddress / PageSize);
+	host = &mainMemory[physicalAddress];
     }
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = *host;
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) host;
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) host;
 	*value = WordToHost(data);
 	break;
 
@@ -129,6 +147,10 @@ Machine::ReadMem(int addr, int size, int *value)
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
+//	As in ReadMem, aligned stores to a page in writeCache skip
+//	Translate.  Pages only get into writeCache after a successful
+//	(so not read-only) write translation.
+//
 //	"addr" -- the virtual address to write to
 //	"size" -- the number of bytes to be written (1, 2, or 4)
 //	"value" -- the data to be written
@@ -139,27 +161,45 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
-     
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    char *host;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    FastTLBEntry *fast = &writeCache[vpn % FastTLBSize];
+
+    if ((fast->virtualPage == (int) vpn) && !(addr & (size - 1))) {
+	fast->entry->time = TLBtime++;
+	fast->entry->freq++;
+	fast->entry->use = TRUE;
+	fast->entry->dirty = TRUE;
+	if (tlbPolicy == TLB_PLRU)
+	    TouchTLB(fast->entry - tlb);
+	host = fast->page + (unsigned) addr % PageSize;
+	physicalAddress = host - mainMemory;
+    } else {
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	FillFastTLB(writeCache, vpn, physicalAddress / PageSize);
+	host = &mainMemory[physicalAddress];
     }
+    decodeValid[physicalAddress / 4] = FALSE;	// the word may hold code
+    if (blockCovered[physicalAddress / 4])
+	FlushBlocks(physicalAddress / PageSize);
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*host = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
+	*(unsigned short *) host
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	*(unsigned int *) host = WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
@@ -168,6 +208,235 @@ Machine::WriteMem(int addr, int size, int value)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::FillFastTLB
+// 	Remember, in "cache" (readCache or writeCache), that virtual page
+//	"vpn" was just translated through the TLB to physical page "frame".
+//	Not done while address translation is being traced, so that
+//	every access still shows up in the -d a output.
+//----------------------------------------------------------------------
+
+void
+Machine::FillFastTLB(FastTLBEntry *cache, unsigned int vpn, int frame)
+{
+    FastTLBEntry *fast = &cache[vpn % FastTLBSize];
+    int set = (vpn & tlbSetMask) * tlbWays;
+
+    if (DebugIsEnabled('a'))
+	return;
+    for (int i = set; i < set + tlbWays; i++)
+	if (tlb[i].valid && (tlb[i].virtualPage == (int) vpn)
+			&& (tlb[i].asid == currentASID)
+			&& (tlb[i].physicalPage == frame)) {
+	    fast->virtualPage = vpn;
+	    fast->page = &mainMemory[frame * PageSize];
+	    fast->entry = &tlb[i];
+	    return;
+	}
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushFastTLB
+// 	Forget the fast translations of virtual page "vpn", or of every
+//	page if "vpn" is -1.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushFastTLB(int vpn)
+{
+    for (int i = 0; i < FastTLBSize; i++) {
+	if ((vpn == -1) || (readCache[i].virtualPage == vpn))
+	    readCache[i].virtualPage = -1;
+	if ((vpn == -1) || (writeCache[i].virtualPage == vpn))
+	    writeCache[i].virtualPage = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::LoadTLB
+// 	Install a translation in TLB slot "index", replacing whatever
+//	was there.  The kernel must use this (or FlushTLB), rather than
+//	changing the TLB directly, so that readCache and writeCache never
+//	refer to a translation that the TLB no longer holds.
+//----------------------------------------------------------------------
+
+void
+Machine::LoadTLB(int index, TranslationEntry *entry)
+{
+    ASSERT((index >= 0) && (index < tlbSize));
+    ASSERT(index / tlbWays == (entry->virtualPage & tlbSetMask));
+    if (tlb[index].valid)
+	FlushFastTLB(tlb[index].virtualPage);
+    tlb[index] = *entry;
+    TouchTLB(index);
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTLB
+// 	Invalidate every entry in the TLB.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTLB()
+{
+    for (int i = 0; i < tlbSize; i++)
+	tlb[i].valid = FALSE;
+    FlushFastTLB(-1);
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTLBFrame
+// 	Invalidate any TLB entry, whatever its address space, that maps
+//	to physical page "frame".  Since TLB entries are tagged with their
+//	address space, and not flushed on a context switch, the kernel
+//	must call this whenever it takes a frame away from a page.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTLBFrame(int frame)
+{
+    for (int i = 0; i < tlbSize; i++)
+	if (tlb[i].valid && (tlb[i].physicalPage == frame)) {
+	    tlb[i].valid = FALSE;
+	    FlushFastTLB(tlb[i].virtualPage);
+	}
+}
+
+//----------------------------------------------------------------------
+// Machine::SetASID
+// 	Start using the TLB entries of address space "asid" (and no
+//	others).  The fast translations are only for the running address
+//	space, so they are dropped if it changes.
+//----------------------------------------------------------------------
+
+void
+Machine::SetASID(int asid)
+{
+    if (asid != currentASID) {
+	currentASID = asid;
+	FlushFastTLB(-1);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::ConfigureTLB
+// 	Replace the TLB with an empty one of "size" entries, divided into
+//	sets of "ways" entries.  A translation for virtual page vpn can
+//	only go in set (vpn % number of sets), so Translate only has to
+//	look at "ways" entries.  Both must be powers of two; ways == size
+//	gives a fully associative TLB, as the original Nachos had.
+//
+//	"policy" is how TLBVictim chooses the entry to replace in a set.
+//----------------------------------------------------------------------
+
+void
+Machine::ConfigureTLB(int size, int ways, TLBPolicy policy)
+{
+    int sets = size / ways;
+
+    ASSERT((size > 0) && ((size & (size - 1)) == 0));
+    ASSERT((ways > 0) && ((ways & (ways - 1)) == 0) && (ways <= size));
+    delete [] tlb;
+    delete [] tlbNext;
+    delete [] tlbTree;
+    tlbSize = size;
+    tlbWays = ways;
+    tlbSetMask = sets - 1;
+    tlbPolicy = policy;
+    tlb = new TranslationEntry[size];
+    tlbNext = new int[sets];
+    tlbTree = new char[size];
+    for (int i = 0; i < size; i++) {
+	tlb[i].valid = FALSE;
+	tlb[i].time = 0;
+	tlbTree[i] = 0;
+    }
+    for (int i = 0; i < sets; i++)
+	tlbNext[i] = 0;
+    FlushFastTLB(-1);
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBVictim
+// 	Return the TLB slot that a translation for "vpn" should replace:
+//	a free entry of its set if there is one, and otherwise the one
+//	"tlbPolicy" picks.
+//
+//	For pseudo-LRU, the bits of a set form a binary tree over its
+//	entries (node n has children 2n and 2n+1; the entries are the
+//	leaves tlbWays .. 2 * tlbWays - 1).  Each bit points to the half
+//	that was used less recently, so following them from the root
+//	leads to the entry to replace.
+//----------------------------------------------------------------------
+
+int
+Machine::TLBVictim(unsigned int vpn)
+{
+    int set = vpn & tlbSetMask;
+    TranslationEntry *entries = &tlb[set * tlbWays];
+    char *tree = &tlbTree[set * tlbWays];
+    int i, victim, node;
+
+    for (i = 0; i < tlbWays; i++)
+	if (!entries[i].valid)
+	    return set * tlbWays + i;
+    switch (tlbPolicy) {
+      case TLB_LRU:
+	victim = 0;
+	for (i = 1; i < tlbWays; i++)
+	    if (entries[i].time < entries[victim].time)
+		victim = i;
+	break;
+
+      case TLB_PLRU:
+	for (node = 1; node < tlbWays; )
+	    node = 2 * node + tree[node];
+	victim = node - tlbWays;
+	break;
+
+      case TLB_RANDOM:
+	victim = Random() % tlbWays;
+	break;
+
+      case TLB_FIFO:
+	victim = tlbNext[set];
+	tlbNext[set] = (victim + 1) % tlbWays;
+	break;
+
+      default: ASSERT(FALSE);
+    }
+    return set * tlbWays + victim;
+}
+
+//----------------------------------------------------------------------
+// Machine::TouchTLB
+// 	Note that TLB slot "index" was just used, for the replacement
+//	policy.  Translate already keeps "time" up to date for LRU, so
+//	only pseudo-LRU has any work to do on a hit: it points the bits
+//	on the path to the entry away from it.
+//----------------------------------------------------------------------
+
+void
+Machine::TouchTLB(int index)
+{
+    int way = index & (tlbWays - 1);
+    char *tree = &tlbTree[index - way];
+
+    switch (tlbPolicy) {
+      case TLB_LRU:
+	tlb[index].time = TLBtime++;
+	break;
+
+      case TLB_PLRU:
+	for (int node = tlbWays + way; node > 1; node /= 2)
+	    tree[node / 2] = !(node & 1);
+	break;
+
+      default:
+	break;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -228,11 +497,15 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 */
 		if(0) ;
 		else {
-        	for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    	if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+    		int set = (vpn & tlbSetMask) * tlbWays;
+        	for (entry = NULL, i = set; i < set + tlbWays; i++)
+    	    	if (tlb[i].valid && (tlb[i].virtualPage == vpn)
+					&& (tlb[i].asid == currentASID)) {
 					entry = &tlb[i];			// FOUND!
 					tlb[i].time = TLBtime ++ ;
 					tlb[i].freq ++ ;
+					if (tlbPolicy == TLB_PLRU)
+						TouchTLB(i);
 					break;
 	    		}
 				if (entry == NULL) {				// not found
@@ -241,7 +514,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     	    		if( tlbAccess > 100000 && tlbAccess %100000 < 5)
     	    		{
     	    			printf("TLBAccess:%d, tvpn: %d, vaddr: %d\n", tlbAccess, vpn, virtAddr) ;
-    	    			for (entry = NULL, i = 0; i < TLBSize; i++)
+    	    			for (entry = NULL, i = 0; i < tlbSize; i++)
     	    			{
     	    				entry = &tlb[i];
     	    				printf("v:%d, p:%d, t:%d\n", entry->virtualPage, entry->physicalPage, entry->time) ;
@@ -42,6 +42,19 @@ class TranslationEntry {
 			// page is modified.
 	int freq ;
 	int time ;
+    int asid;		// The address space the translation belongs to.  A
+			// TLB entry is only used while that space is running
+			// (see Machine::SetASID).
+};
+
+// A host-side shortcut for a translation that is currently in the TLB,
+// used by ReadMem and WriteMem to skip Translate (see translate.cc).
+
+class FastTLBEntry {
+  public:
+    int virtualPage;		// -1 if the entry is unused
+    char *page;			// where the page starts in mainMemory
+    TranslationEntry *entry;	// the TLB entry it was filled from
 };
 
 #endif
@@ -8,20 +8,27 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -mlfq -cfs
+//		-s -bb -tlb <entries> <ways> <policy>
+//		-x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
-//              -z
+//              -z -eq <count>
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -mlfq schedules threads with a multi-level feedback queue
+//    -cfs schedules threads by weighted virtual runtime
 //    -z prints the copyright message
+//    -eq times the scheduling and firing of <count> interrupts
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bb runs user programs with the basic-block engine (mipsblock.cc)
+//    -tlb sets the TLB size and associativity (powers of two), and
+//	the entry it replaces on a miss: lru, plru, random or fifo
 //    -x runs a user program
 //    -c tests the console
 //
@@ -63,6 +70,7 @@ extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void), DirectoryTest(void), FileThreadTest();
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
+extern void EventQueueTest(int count);
 extern void printHello() ;
 
 //----------------------------------------------------------------------
@@ -115,6 +123,11 @@ main(int argc, char **argv)
 		argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
             printf (copyright);
+        else if (!strcmp(*argv, "-eq")) {	// time the interrupt queue
+	    ASSERT(argc > 1);
+            EventQueueTest(atoi(*(argv + 1)));
+            argCount = 2;
+        }
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {        	// run a user program
 	    ASSERT(argc > 1);
@@ -11,8 +11,10 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	With priority scheduling ("iftime"), the highest priority ready
+//	thread runs first, FIFO within a priority; otherwise straight FIFO.
+//	There are also a multi-level feedback queue and a completely
+//	fair policy, selected with -mlfq and -cfs (see scheduler.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -27,23 +29,68 @@
 // 	Initialize the list of ready but not running threads to empty.
 //----------------------------------------------------------------------
 
-extern bool iftime, syn ;
+extern bool iftime, syn, mlfq, cfs ;
+
+// Completely fair scheduler weight of each priority, as for UNIX nice
+// values 0 to 19.
+
+static const int fairWeight[CFSLevels] = {
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+};
+
+static int
+FairWeight(Thread *thread)
+{
+    if (thread->prior < 0)
+	return fairWeight[0];
+    if (thread->prior >= CFSLevels)
+	return fairWeight[CFSLevels - 1];
+    return fairWeight[thread->prior];
+}
+
+//----------------------------------------------------------------------
+// ShouldYield
+// 	The time slice of thread "arg" is up.  Since Run cancels the
+//	slice of a thread when it switches away from it, "arg" is
+//	normally still the current thread; the exception is a thread
+//	that blocked while the machine had nothing else to run.
+//----------------------------------------------------------------------
 
 void ShouldYield(int arg)
 {
-	int tid = arg%1000 ;
-	int version = arg/1000 ;
-	//printf("t:%d, v:%d\n", tid, version) ;
-	if(tid == currentThread->getTid() && version == currentThread->version)
+	scheduler->slice = NULL ;
+	if((Thread *) arg == currentThread)
 	{
-		//printf("Y\n") ;
+		if(mlfq) scheduler->Demote(currentThread) ;
 		interrupt->YieldOnReturn();
 	}
 }
 
+//----------------------------------------------------------------------
+// MLFQBoost
+// 	Timer interrupt handler for the multi-level feedback queue: every
+//	MLFQBoostTicks, move every thread back to the top level, so that
+//	threads that have sunk to the bottom are not starved.
+//----------------------------------------------------------------------
+
+void MLFQBoost(int dummy)
+{
+	scheduler->Boost() ;
+	interrupt->Schedule(MLFQBoost, 0, MLFQBoostTicks, TimerInt) ;
+}
+
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
+    for (int i = 0; i < NumPriorities; i++)
+	readyHead[i] = readyTail[i] = NULL;
+    readyMask = 0;
+    slice = NULL ;
+    fairSize = 16;
+    fairHeap = new Thread *[fairSize];
+    fairCount = fairLoad = fairSeq = 0;
+    minVruntime = runStart = 0;
+    zombies = NULL;
 } 
 
 //----------------------------------------------------------------------
@@ -53,9 +100,49 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    delete [] fairHeap;
 } 
 
+//----------------------------------------------------------------------
+// Scheduler::ReadyLevel
+// 	Return the ready queue "thread" belongs on.  With priority
+//	scheduling, that is its priority, clamped to the levels we have
+//	(the feedback in Thread::Yield keeps lowering the priority of a
+//	thread that uses up its slices); otherwise every thread goes on
+//	queue 0, and the ready list is plain FIFO.
+//----------------------------------------------------------------------
+
+int
+Scheduler::ReadyLevel(Thread *thread)
+{
+    if (mlfq)
+	return thread->mlfqLevel;
+    if (!iftime || thread->prior < 0)
+	return 0;
+    if (thread->prior >= NumPriorities)
+	return NumPriorities - 1;
+    return thread->prior;
+}
+
+//----------------------------------------------------------------------
+// LowestBit
+// 	Return the number of the lowest bit set in "mask", which must not
+//	be 0, without looping over the bits: "mask & -mask" isolates the
+//	bit, and multiplying by a de Bruijn sequence puts a different
+//	pattern in the top 5 bits for each of the 32 possible bits.
+//----------------------------------------------------------------------
+
+static const int deBruijnBit[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+static int
+LowestBit(unsigned int mask)
+{
+    return deBruijnBit[((mask & -mask) * 0x077CB531U) >> 27];
+}
+
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
@@ -79,9 +166,29 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    ASSERT(thread->status != READY);	// it would be on two queues
+    if (cfs) {
+	if (thread == currentThread)		// yielding
+	    Charge(thread);
+	else if (thread->status == JUST_CREATED)
+	    thread->vruntime = minVruntime;
+	else if (thread->vruntime < minVruntime - CFSLatency / 2)
+	    thread->vruntime = minVruntime - CFSLatency / 2;	// waking up
+	thread->setStatus(READY);
+	FairInsert(thread);
+	return;
+    }
+
+    int level = ReadyLevel(thread);
+
     thread->setStatus(READY);
-    if(iftime) readyList->SortedInsert((void *)thread, thread->prior);
-    else readyList->Append((void *)thread);
+    thread->readyNext = NULL;
+    if (readyTail[level] == NULL)
+	readyHead[level] = thread;
+    else
+	readyTail[level]->readyNext = thread;
+    readyTail[level] = thread;
+    readyMask |= (1 << level);
 }
 
 //----------------------------------------------------------------------
@@ -95,7 +202,168 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    Thread *thread;
+    int level;
+
+    if (cfs)
+	return FairRemove();
+    if (readyMask == 0)
+	return NULL;
+    level = LowestBit(readyMask);
+    thread = readyHead[level];
+    readyHead[level] = thread->readyNext;
+    if (readyHead[level] == NULL) {
+	readyTail[level] = NULL;
+	readyMask &= ~(1 << level);
+    }
+    thread->readyNext = NULL;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Demote
+// 	"thread" used up its whole quantum: move it down a level, where
+//	the quantum is twice as long, unless it is already at the bottom.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Demote(Thread *thread)
+{
+    if (thread->mlfqLevel < MLFQLevels - 1)
+	thread->mlfqLevel++;
+    thread->sliceLeft = 0;
+    DEBUG('t', "Thread \"%s\" demoted to level %d\n", thread->getName(),
+	  thread->mlfqLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::BlockedOnIO
+// 	"thread" is about to wait for a device (see Semaphore::forIO).
+//	Under the multi-level feedback queue, move it up a level, so that
+//	I/O-bound threads get the CPU soon after their I/O completes.
+//	It gets a fresh quantum when it next runs.
+//----------------------------------------------------------------------
+
+void
+Scheduler::BlockedOnIO(Thread *thread)
+{
+    if (!mlfq)
+	return;
+    if (thread->mlfqLevel > 0)
+	thread->mlfqLevel--;
+    thread->sliceLeft = 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Put every thread back at the top level of the multi-level
+//	feedback queue, with a fresh quantum.  The ready threads are
+//	moved to queue 0 in the order they would have run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost()
+{
+    DEBUG('t', "Boosting all threads to level 0\n");
+    for (int i = 1; i <= threadTable->MaxTid(); i++) {
+	Thread *thread = threadTable->Lookup(i);
+
+	if (thread != NULL) {
+	    thread->mlfqLevel = 0;
+	    thread->sliceLeft = 0;
+	}
+    }
+    for (int level = 1; level < MLFQLevels; level++) {
+	if (readyHead[level] == NULL)
+	    continue;
+	if (readyTail[0] == NULL)
+	    readyHead[0] = readyHead[level];
+	else
+	    readyTail[0]->readyNext = readyHead[level];
+	readyTail[0] = readyTail[level];
+	readyHead[level] = readyTail[level] = NULL;
+	readyMask &= ~(1 << level);
+	readyMask |= 1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Charge
+// 	Add the time the current thread has run since it was last
+//	charged, scaled by its weight, to its virtual runtime.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge(Thread *thread)
+{
+    int ran = stats->totalTicks - runStart;
+
+    runStart = stats->totalTicks;
+    thread->vruntime += ran * CFSNiceZero / FairWeight(thread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FairBefore, FairInsert, FairRemove
+// 	The heap of ready threads for the completely fair scheduler,
+//	ordered by vruntime, and among equal vruntimes, by when they were
+//	made ready.  FairRemove returns NULL if no thread is ready.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::FairBefore(Thread *a, Thread *b)
+{
+    return (a->vruntime < b->vruntime) ||
+	((a->vruntime == b->vruntime) && (a->readySeq < b->readySeq));
+}
+
+void
+Scheduler::FairInsert(Thread *thread)
+{
+    int i, parent;
+
+    if (fairCount == fairSize) {
+	Thread **bigger = new Thread *[fairSize * 2];
+
+	for (i = 0; i < fairCount; i++)
+	    bigger[i] = fairHeap[i];
+	delete [] fairHeap;
+	fairHeap = bigger;
+	fairSize *= 2;
+    }
+    thread->readySeq = fairSeq++;
+    fairLoad += FairWeight(thread);
+    for (i = fairCount++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!FairBefore(thread, fairHeap[parent]))
+	    break;
+	fairHeap[i] = fairHeap[parent];
+    }
+    fairHeap[i] = thread;
+}
+
+Thread *
+Scheduler::FairRemove()
+{
+    Thread *first, *last;
+    int i, child;
+
+    if (fairCount == 0)
+	return NULL;
+    first = fairHeap[0];
+    last = fairHeap[--fairCount];
+    for (i = 0; (child = 2 * i + 1) < fairCount; i = child) {
+	if ((child + 1 < fairCount) && FairBefore(fairHeap[child + 1],
+						 fairHeap[child]))
+	    child++;
+	if (!FairBefore(fairHeap[child], last))
+	    break;
+	fairHeap[i] = fairHeap[child];
+    }
+    fairHeap[i] = last;
+    fairLoad -= FairWeight(first);
+    if (first->vruntime > minVruntime)
+	minVruntime = first->vruntime;
+    return first;
 }
 
 //----------------------------------------------------------------------
@@ -117,13 +385,7 @@ Scheduler::Run (Thread *nextThread)
 {
     Thread *oldThread = currentThread;
     
-#ifdef USER_PROGRAM			// ignore until running user programs 
-    if (currentThread->space != NULL) {	// if this thread is a user program,
-        currentThread->SaveUserState(); // save the user's CPU registers
-	currentThread->space->SaveState();
-    }
-#endif
-    
+
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
@@ -144,22 +406,39 @@ Scheduler::Run (Thread *nextThread)
     // of view of the thread and from the perspective of the "outside world".
 	
 	//̵ 
-	if(iftime) interrupt->Schedule(ShouldYield, nextThread->getTid()+
-				(++nextThread->version)*1000, nextThread->TimeTick, TimerInt);
-	if(syn) interrupt->Schedule(ShouldYield, nextThread->getTid()+
-				(++nextThread->version)*1000, Random() % (TimerTicks * 2), TimerInt);
-	//printf("I-t:%d, v:%d\n", nextThread->getTid(), nextThread->version) ;
-
-#ifdef USER_PROGRAM
-	if( machine->tlb != NULL )
-	{
-		int i = 0 ;
-		for( ; i < 4; i ++ ) // TLBSize = 4
-		{
-			(machine->tlb[i]).valid = 0 ;
-		}
+	// the old thread's slice, if any, is over: take it out of the
+	// interrupt queue rather than letting it fire for nothing.
+	// Under MLFQ a thread that is preempted or yields keeps what is
+	// left of its quantum, so yielding just before it runs out does
+	// not keep it at a high level
+	if(slice != NULL){
+		if(mlfq && oldThread->status != BLOCKED)
+			oldThread->sliceLeft = slice->when - stats->totalTicks ;
+		interrupt->Cancel(slice) ;
+		slice = NULL ;
 	}
-#endif
+	if(cfs){
+		Charge(oldThread) ;
+		int weight = FairWeight(nextThread) ;
+		int quantum = CFSLatency * weight / (fairLoad + weight) ;
+		if(quantum < CFSMinSlice) quantum = CFSMinSlice ;
+		slice = interrupt->Schedule(ShouldYield, (int) nextThread,
+				quantum, TimerInt);
+	}
+	if(mlfq){
+		int quantum = nextThread->sliceLeft ;
+		if(quantum <= 0) quantum = MLFQQuantum(nextThread->mlfqLevel) ;
+		nextThread->sliceLeft = 0 ;
+		slice = interrupt->Schedule(ShouldYield, (int) nextThread,
+				quantum, TimerInt);
+	}
+	if(iftime) slice = interrupt->Schedule(ShouldYield, (int) nextThread,
+				nextThread->TimeTick, TimerInt);
+	if(syn) slice = interrupt->Schedule(ShouldYield, (int) nextThread,
+				1 + Random() % (TimerTicks * 2), TimerInt);
+
+	// the TLB is not flushed: its entries are tagged with their address
+	// space, and AddrSpace::RestoreState switches spaces if need be
     SWITCH(oldThread, nextThread);    
     DEBUG('t', "Now in thread \"%s\"\n", currentThread->getName());
     //printf("Sometimes Do not Touch here.\n") ;
@@ -168,21 +447,49 @@ Scheduler::Run (Thread *nextThread)
     // we need to delete its carcass.  Note we cannot delete the thread
     // before now (for example, in Thread::Finish()), because up to this
     // point, we were still running on the old thread's stack!
-    /*
-	if (threadToBeDestroyed != NULL) {
-        delete threadToBeDestroyed;
-		threadToBeDestroyed = NULL;
-    }
-    */
+    Reap();
     
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL) {		// if there is an address space
-        currentThread->RestoreUserState();     // to restore, do it.
-	currentThread->space->RestoreState();
-    }
+    if (currentThread->space != NULL)		// if there is an address space
+        currentThread->LoadUserState();		// to restore, do it (unless
+						// it is still in the machine)
 #endif
 }
 
+//----------------------------------------------------------------------
+// Scheduler::Finished
+// 	"thread" is finishing: remember to delete it once we are no longer
+//	running on its stack.  Finished threads are linked through
+//	readyNext, since they will never be ready again.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Finished(Thread *thread)
+{
+    thread->readyNext = zombies;
+    zombies = thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Reap
+// 	Delete the threads that have finished.  Called just after
+//	switching to a thread, when we are certainly not running on the
+//	stack of any of them.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Reap()
+{
+    Thread *thread;
+
+    while (zombies != NULL) {
+	thread = zombies;
+	zombies = thread->readyNext;
+	ASSERT(thread != currentThread);
+	delete thread;
+    }
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
@@ -192,5 +499,9 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < NumPriorities; i++)
+	for (Thread *t = readyHead[i]; t != NULL; t = t->readyNext)
+	    ThreadPrint((int) t);
+    for (int i = 0; i < fairCount; i++)
+	ThreadPrint((int) fairHeap[i]);
 }
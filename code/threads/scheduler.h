@@ -16,8 +16,48 @@
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// Ready threads are kept in one FIFO queue per priority level, linked
+// through Thread::readyNext, with a bit mask of the levels that are not
+// empty.  So putting a thread on the ready list, and finding and taking
+// off the most important one, take constant time however many threads
+// are ready.  Level 0 runs first.
+
+#define NumPriorities	32	// priority levels; must fit in readyMask
+
+// The multi-level feedback queue policy (-mlfq) uses the first
+// MLFQLevels ready queues.  Threads start at level 0, move down a level
+// each time they use up a whole quantum, and up a level each time they
+// wait for I/O.  The quantum doubles at each level down.  Every
+// MLFQBoostTicks all threads go back to level 0, so that CPU-bound
+// threads still get to run.
+
+#define MLFQLevels	4
+#define MLFQQuantum(level)	(TimerTicks << (level))
+#define MLFQBoostTicks	(TimerTicks * 50)
+
+extern bool mlfq;		// use the multi-level feedback queue?
+
+// The completely fair policy (-cfs) keeps the ready threads in a heap
+// ordered by virtual runtime: the CPU time a thread has used, scaled
+// down by its weight.  The weight comes from "prior", as with UNIX nice
+// values: CFSNiceZero at priority 0, and about 1.25 times less for each
+// step down, to priority CFSLevels - 1.  The thread that has had the
+// least weighted time runs next, for a slice that is its share of
+// CFSLatency, but no less than CFSMinSlice.  A thread that wakes up
+// starts at most CFSLatency / 2 behind the others.
+
+#define CFSLevels	20
+#define CFSNiceZero	1024
+#define CFSLatency	(TimerTicks * 4)
+#define CFSMinSlice	(TimerTicks / 2)
+
+extern bool cfs;		// use the completely fair scheduler?
 
-void ShouldYield(int tid) ;
+class PendingInterrupt;
+
+void ShouldYield(int arg) ;
+void MLFQBoost(int dummy) ;
 
 class Scheduler {
   public:
@@ -30,10 +70,41 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+
+    void Finished(Thread *thread);	// Thread is done; delete it later
+    void Reap();			// Delete the threads that are done
+
+    void Demote(Thread *thread);	// MLFQ: thread used up its quantum
+    void BlockedOnIO(Thread *thread);	// MLFQ: thread is waiting for I/O
+    void Boost();			// MLFQ: move all threads to level 0
+    void Charge(Thread *thread);	// CFS: add the time "thread" has run
+					// to its virtual runtime
+
+    PendingInterrupt *slice;		// timer interrupt that ends the
+					// current thread's time slice, or NULL
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    int ReadyLevel(Thread *thread);	// which queue "thread" goes on
+
+    Thread *readyHead[NumPriorities];	// queues of threads that are ready
+    Thread *readyTail[NumPriorities];	// to run, but not running
+    unsigned int readyMask;		// bit i is set if queue i is not empty
+
+    bool FairBefore(Thread *a, Thread *b); // CFS: should "a" run first?
+    void FairInsert(Thread *thread);
+    Thread *FairRemove();
+
+    Thread **fairHeap;		// CFS: ready threads, as a binary heap
+				// with the least vruntime in fairHeap[0]
+    int fairCount;		// number of threads in the heap
+    int fairSize;		// number of slots allocated in "fairHeap"
+    int fairLoad;		// total weight of the threads in the heap
+    int fairSeq;		// order of insertion, to break ties
+    int minVruntime;		// vruntime of the last thread picked;
+				// never decreases
+    int runStart;		// when the current thread was last charged
+
+    Thread *zombies;		// finished threads, not yet deleted
 };
 
 #endif // SCHEDULER_H
@@ -38,6 +38,7 @@ Semaphore::Semaphore(char* debugName, int initialValue)
     name = debugName;
     value = initialValue;
     queue = new List;
+    forIO = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -67,6 +68,8 @@ Semaphore::P()
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
     while (value <= 0) { 			// semaphore not available
+	if (forIO)
+	    scheduler->BlockedOnIO(currentThread);
 	queue->Append((void *)currentThread);	// so go to sleep
 	currentThread->Sleep();
     } 
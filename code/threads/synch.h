@@ -44,6 +44,9 @@ class Semaphore {
     
     void P();	 // these are the only operations on a semaphore
     void V();	 // they are both *atomic*
+
+    bool forIO;	 // TRUE if threads wait here for a device, rather
+		 // than for another thread (see Scheduler::BlockedOnIO)
     
   private:
     char* name;        // useful for debugging
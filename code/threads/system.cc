@@ -11,19 +11,18 @@
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
 
-int tNum;			//ͳ߳
-int freeTid[129];	//̱߳
 int tlbAccess;
-Thread *Tpool[129];	//ָ߳
+ThreadTable *threadTable;	// every thread, by tid
 bool tsFlag;			//־Ƿӡ߳Ϣ
 bool allowed ;			
 bool iftime ;				//־ǷΪ̵ȵ 
 bool syn ;				//ʶǷΪͬ 
+bool mlfq ;				// multi-level feedback queue scheduling
+bool cfs ;				// completely fair scheduling
 
 //int TimeTick = 50 ;
 
 Thread *currentThread;			// the thread we are running now
-Thread *threadToBeDestroyed;  		// the thread that just finished
 Scheduler *scheduler;			// the ready list
 Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
@@ -92,16 +91,20 @@ Initialize(int argc, char **argv)
     char* debugArgs = "";
     bool randomYield = FALSE;
 
-	tNum = 0;
 	tsFlag = 0;
 	allowed = 0 ;
 	iftime = 0 ;
 	syn = 0 ; 
-	for (int i = 1; i <= 128; i++) freeTid[i] = 1;
+	mlfq = FALSE ;
+	cfs = FALSE ;
 	
 	
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool blockEngine = FALSE;	// run user code a basic block at a time
+    int tlbEntries = TLBSize;	// TLB geometry and replacement policy
+    int tlbWays = TLBSize;
+    TLBPolicy tlbPolicy = TLB_LRU;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -126,10 +129,32 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-mlfq")) {
+	    mlfq = TRUE;
+	} else if (!strcmp(*argv, "-cfs")) {
+	    cfs = TRUE;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-bb"))
+	    blockEngine = TRUE;
+	else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 3);
+	    tlbEntries = atoi(*(argv + 1));
+	    tlbWays = atoi(*(argv + 2));
+	    if (!strcmp(*(argv + 3), "lru"))
+		tlbPolicy = TLB_LRU;
+	    else if (!strcmp(*(argv + 3), "plru"))
+		tlbPolicy = TLB_PLRU;
+	    else if (!strcmp(*(argv + 3), "random"))
+		tlbPolicy = TLB_RANDOM;
+	    else if (!strcmp(*(argv + 3), "fifo"))
+		tlbPolicy = TLB_FIFO;
+	    else
+		ASSERT(FALSE);
+	    argCount = 4;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -154,7 +179,10 @@ Initialize(int argc, char **argv)
     scheduler = new Scheduler();		// initialize the ready queue
     if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
-    threadToBeDestroyed = NULL;
+    if (mlfq)					// start the periodic boost
+	interrupt->Schedule(MLFQBoost, 0, MLFQBoostTicks, TimerInt);
+
+    threadTable = new ThreadTable();		// hands out tids
 
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
@@ -167,6 +195,8 @@ Initialize(int argc, char **argv)
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
+    machine->useBlocks = blockEngine;
+    machine->ConfigureTLB(tlbEntries, tlbWays, tlbPolicy);
 #endif
 
 #ifdef FILESYS
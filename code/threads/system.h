@@ -25,7 +25,6 @@ extern void Cleanup();				// Cleanup, called when
 extern Thread * createThread(char*);
 extern void TS();
 extern Thread *currentThread;			// the thread holding the CPU
-extern Thread *threadToBeDestroyed;  		// the thread that just finished
 extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
@@ -24,24 +24,151 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+//----------------------------------------------------------------------
+// GetStack, PutStack
+//	Execution stacks are recycled: the stack of a deleted thread goes
+//	on a pool (linked through its first word), and the next Fork takes
+//	it from there, rather than mapping a new one.  At most StackPoolSize
+//	stacks are kept; the rest are unmapped.
+//
+//	A new stack has unmapped guard pages on both sides (see
+//	AllocBoundedArray), and is touched all the way through, so that
+//	the host does not have to fault its pages in while the thread runs.
+//----------------------------------------------------------------------
+
+#define StackPoolSize	32
+
+static int *stackPool = NULL;		// free stacks
+static int stackPoolCount = 0;		// how many
+
+static int *
+GetStack()
+{
+    int *stack = stackPool;
+
+    if (stack != NULL) {
+	stackPool = *(int **) stack;
+	stackPoolCount--;
+	return stack;
+    }
+    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    bzero((char *) stack, StackSize * sizeof(int));
+    return stack;
+}
+
+static void
+PutStack(int *stack)
+{
+    if (stackPoolCount == StackPoolSize) {
+	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+	return;
+    }
+    *(int **) stack = stackPool;
+    stackPool = stack;
+    stackPoolCount++;
+}
+
 void TS() {
 	if (tsFlag == 0) return;
-	for (int i = 1; i <= 128; ++i) {
-		if (freeTid[i] == 0) {
-			printf("uid: %d\ttid: %d\tname: %s\tstatus:%d\n", Tpool[i]->getUid(), Tpool[i]->getTid(), Tpool[i]->getName(), Tpool[i]->getStatus());
+	for (int i = 1; i <= threadTable->MaxTid(); ++i) {
+		Thread *t = threadTable->Lookup(i);
+		if (t != NULL) {
+			printf("uid: %d\ttid: %d\tname: %s\tstatus:%d\n", t->getUid(), t->getTid(), t->getName(), t->getStatus());
 		}
 	}
 }
 
 Thread* createThread(char* threadName, int prior = 0)
 {
-	Thread* newThread;
-	if (tNum < 128)
-	{
-		newThread = new Thread(threadName, prior);
+	return new Thread(threadName, prior);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize an empty thread table.  It gets its first slots when
+//	the first thread is added.  Tid 0 is never used.
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    size = 0;
+    threads = NULL;
+    nextFree = NULL;
+    freeHead = freeTail = 0;
+    numThreads = 0;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::~ThreadTable
+// 	De-allocate the table (but not the threads in it).
+//----------------------------------------------------------------------
+
+ThreadTable::~ThreadTable()
+{
+    delete [] threads;
+    delete [] nextFree;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Add
+// 	Give "thread" the free tid that has been free the longest, and
+//	return it.  If there is none, the table is doubled first (starting
+//	at 32 slots), and the new tids go on the end of the free list.
+//----------------------------------------------------------------------
+
+int
+ThreadTable::Add(Thread *thread)
+{
+    int tid;
+
+    if (freeHead == 0) {
+	int bigger = (size == 0) ? 32 : size * 2;
+	Thread **newThreads = new Thread *[bigger];
+	int *newNext = new int[bigger];
+
+	for (tid = 0; tid < size; tid++) {
+	    newThreads[tid] = threads[tid];
+	    newNext[tid] = nextFree[tid];
 	}
-	else newThread = NULL;
-	return newThread;
+	for (tid = (size == 0) ? 1 : size; tid < bigger; tid++) {
+	    newThreads[tid] = NULL;
+	    newNext[tid] = (tid + 1 < bigger) ? tid + 1 : 0;
+	}
+	freeHead = (size == 0) ? 1 : size;
+	freeTail = bigger - 1;
+	delete [] threads;
+	delete [] nextFree;
+	threads = newThreads;
+	nextFree = newNext;
+	size = bigger;
+    }
+    tid = freeHead;
+    freeHead = nextFree[tid];
+    if (freeHead == 0)
+	freeTail = 0;
+    threads[tid] = thread;
+    numThreads++;
+    return tid;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Remove
+// 	Put the tid of a thread that is being deleted on the end of the
+//	free list.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Remove(int tid)
+{
+    ASSERT(Lookup(tid) != NULL);
+    threads[tid] = NULL;
+    nextFree[tid] = 0;
+    if (freeTail == 0)
+	freeHead = tid;
+    else
+	nextFree[freeTail] = tid;
+    freeTail = tid;
+    numThreads--;
 }
 
 
@@ -55,7 +182,6 @@ Thread* createThread(char* threadName, int prior = 0)
 
 Thread::Thread(char* threadName, int priority)
 {
-    static int i = 1 ;
 	name = threadName;
     stackTop = NULL;
     stack = NULL;
@@ -66,20 +192,14 @@ Thread::Thread(char* threadName, int priority)
     
 	TimeTick = 100 ; //ʱƬת 
     
-	version = 0 ;
+	readyNext = NULL ;
+	mlfqLevel = 0 ;
+	sliceLeft = 0 ;
+	vruntime = 0 ;
+	readySeq = 0 ;
 
 	uid = 1;
-	for (; i <= 128; i++)
-	{
-		if (freeTid[i])
-		{
-			freeTid[i] = 0;
-			Tpool[i] = this;
-			tid = i;
-			break;
-		}
-	}
-	tNum++;
+	tid = threadTable->Add(this);
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -101,13 +221,14 @@ Thread::~Thread()
 {
     printf("delete: %s, %d\n", name, tid) ;
 	DEBUG('t', "Deleting thread \"%s\"\n", name);
-	freeTid[tid] = 1;
-	tNum--;
+	threadTable->Remove(tid);
 
     ASSERT(this != currentThread);
     if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+	PutStack(stack);
 #ifdef USER_PROGRAM
+    if (machine != NULL && machine->registerOwner == this)
+	machine->registerOwner = NULL;
     if( space != NULL ) delete space ;
 #endif
 }
@@ -179,12 +300,12 @@ Thread::CheckOverflow()
 //
 // 	NOTE: we don't immediately de-allocate the thread data structure 
 //	or the execution stack, because we're still running in the thread 
-//	and we're still on the stack!  Instead, we set "threadToBeDestroyed", 
-//	so that Scheduler::Run() will call the destructor, once we're
-//	running in the context of a different thread.
+//	and we're still on the stack!  Instead, we put it on the scheduler's
+//	list of finished threads, so that Scheduler::Reap will call the
+//	destructor, once we're running in the context of a different thread.
 //
 // 	NOTE: we disable interrupts, so that we don't get a time slice 
-//	between setting threadToBeDestroyed, and going to sleep.
+//	between going on the list, and going to sleep.
 //----------------------------------------------------------------------
 
 //
@@ -197,7 +318,7 @@ Thread::Finish ()
     printf("Finish Thread: %s\n", name) ;
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
     
-    threadToBeDestroyed = currentThread;
+    scheduler->Finished(this);
     Sleep();					// invokes SWITCH
     // not reached
 }
@@ -287,15 +408,19 @@ Thread::Sleep ()
 }
 
 //----------------------------------------------------------------------
-// ThreadFinish, InterruptEnable, ThreadPrint
+// ThreadFinish, ThreadBegin, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
 //	function.  So in order to do this, we create a dummy C function
 //	(which we can pass a pointer to), that then simply calls the 
 //	member function.
+//
+//	ThreadBegin is the first thing a new thread does.  Besides enabling
+//	interrupts, it deletes any finished threads, since a new thread
+//	does not get to the Reap at the end of Scheduler::Run.
 //----------------------------------------------------------------------
 
 static void ThreadFinish()    { currentThread->Finish(); }
-static void InterruptEnable() { interrupt->Enable(); }
+static void ThreadBegin()     { scheduler->Reap(); interrupt->Enable(); }
 void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 
 //----------------------------------------------------------------------
@@ -313,7 +438,7 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    stack = GetStack();
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
@@ -338,7 +463,7 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 #endif  // HOST_SNAKE
     
     machineState[PCState] = (int) ThreadRoot;
-    machineState[StartupPCState] = (int) InterruptEnable;
+    machineState[StartupPCState] = (int) ThreadBegin;
     machineState[InitialPCState] = (int) func;
     machineState[InitialArgState] = arg;
     machineState[WhenDonePCState] = (int) ThreadFinish;
@@ -359,8 +484,8 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 void
 Thread::SaveUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	userRegisters[i] = machine->ReadRegister(i);
+    bcopy((char *) machine->registers, (char *) userRegisters, 
+	  sizeof(userRegisters));
 }
 
 //----------------------------------------------------------------------
@@ -375,7 +500,35 @@ Thread::SaveUserState()
 void
 Thread::RestoreUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	machine->WriteRegister(i, userRegisters[i]);
+    bcopy((char *) userRegisters, (char *) machine->registers, 
+	  sizeof(userRegisters));
+}
+
+//----------------------------------------------------------------------
+// Thread::LoadUserState
+//	Make sure the machine's registers and address space are this
+//	thread's, before it runs user code.
+//
+//	User state is switched lazily: the machine's registers stay with
+//	the last user thread that ran (machine->registerOwner) while
+//	kernel-only threads run, and are only saved when a different user
+//	thread needs them.  So switching to a kernel thread and back, or
+//	from a thread to itself, costs nothing.
+//----------------------------------------------------------------------
+
+void
+Thread::LoadUserState()
+{
+    Thread *owner = machine->registerOwner;
+
+    if (owner == this)
+	return;
+    if (owner != NULL) {
+	owner->SaveUserState();
+	owner->space->SaveState();
+    }
+    RestoreUserState();
+    space->RestoreState();
+    machine->registerOwner = this;
 }
 #endif
@@ -87,9 +87,14 @@ class Thread {
   public:
   	int prior;
   	int oldprior ;
-  	int version ;
   	int TimeTick ;
   	int UsedTime ;
+  	Thread *readyNext ;		// next thread on the same ready queue
+  	int mlfqLevel ;			// feedback queue level (see scheduler.h)
+  	int sliceLeft ;			// ticks of its quantum left, or 0 for
+  					// a fresh quantum
+  	int vruntime ;			// weighted ticks run (completely fair
+  	int readySeq ;			// scheduler); when it was made ready
     Thread(char* debugName, int prior=5);		// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
@@ -138,16 +143,43 @@ class Thread {
   public:
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
+    void LoadUserState();		// put this thread's user state in the
+					// machine, if it isn't already
 
     AddrSpace *space;			// User code this thread is running.
 #endif
 };
 
+// The following class defines the table of all existing threads, which
+// gives each thread its tid.  The table grows as needed, so there is
+// no limit on the number of threads.  Free tids are kept on a FIFO list
+// threaded through the table, so that getting and releasing a tid take
+// constant time, and a tid is reused as late as possible.
+
+class ThreadTable {
+  public:
+    ThreadTable();			// initialize an empty table
+    ~ThreadTable();			// de-allocate the table
+
+    int Add(Thread *thread);		// give "thread" a tid, and return it
+    void Remove(int tid);		// release the tid of a deleted thread
+    Thread *Lookup(int tid)		// the thread with this tid, or NULL
+	{ return (tid > 0 && tid < size) ? threads[tid] : NULL; }
+    int MaxTid() { return size - 1; }	// no tid is larger than this
+    int NumThreads() { return numThreads; }
+
+  private:
+    Thread **threads;		// threads[tid], or NULL if tid is free
+    int *nextFree;		// the free tid after tid, or 0 at the end
+    int size;			// number of slots in "threads"
+    int freeHead, freeTail;	// first and last free tid, or 0 if none
+    int numThreads;		// number of tids in use
+};
+
+extern ThreadTable *threadTable;
+
 // Magical machine-dependent routines, defined in switch.s
 
-extern int freeTid[129];
-extern Thread* Tpool[129];
-extern int tNum;
 extern bool tsFlag, iftime;
 Thread * createThread(char*, int prior);
 void TS();
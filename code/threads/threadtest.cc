@@ -12,6 +12,7 @@
 #include "copyright.h"
 #include "system.h"
 #include "synch.h"
+#include <time.h>
 // testnum is set in main.cc
 int testnum = 1;
 int max = 3, num = 0, reader ; //߶г 
@@ -51,11 +52,8 @@ void SimpleThread(int which)
 
 void WakeUp(int arg)
 {
-	int tid = arg%1000 ;
-	int version = arg/1000 ;
-	//printf("t:%d, v:%d\n", tid, version) ;
-	Thread* t = Tpool[tid];
-	if(version = t->version) scheduler->JustCreated(t) ;
+	Thread* t = (Thread *) arg;
+	scheduler->JustCreated(t) ;
 }
 
 void TimeAdvance(int none)
@@ -76,8 +74,7 @@ void TimeAdvance(int none)
 		}
 		if(advance == -2) 
 		{
-			interrupt->Schedule(WakeUp, currentThread->getTid()+
-							(++currentThread->version)*1000, 50, TimerInt);
+			interrupt->Schedule(WakeUp, (int) currentThread, 50, TimerInt);
 			IntStatus oldLevel = interrupt->SetLevel(IntOff);
 			currentThread->Sleep();
 			(void) interrupt->SetLevel(oldLevel);
@@ -426,3 +423,45 @@ ThreadTest()
     }
 }
 
+
+//----------------------------------------------------------------------
+// EventQueueTest
+// 	Measure how fast the interrupt simulation schedules and fires
+//	interrupts.  EventTestDepth interrupts are kept pending: each one,
+//	when it fires, schedules another a random time ahead, until
+//	"count" have fired.  Prints the rate in events per second of
+//	host CPU time.  Run with "nachos -eq <count>".
+//----------------------------------------------------------------------
+
+#define EventTestDepth	64
+
+static int eventsFired, eventsWanted;
+
+static void
+EventTestHandler(int arg)
+{
+    eventsFired++;
+    if (eventsFired + EventTestDepth <= eventsWanted)
+	interrupt->Schedule(EventTestHandler, arg,
+			1 + Random() % (EventTestDepth * SystemTick), TimerInt);
+}
+
+void
+EventQueueTest(int count)
+{
+    clock_t start;
+    double seconds;
+
+    eventsFired = 0;
+    eventsWanted = count;
+    start = clock();
+    for (int i = 0; i < EventTestDepth && i < count; i++)
+	interrupt->Schedule(EventTestHandler, i,
+			1 + Random() % (EventTestDepth * SystemTick), TimerInt);
+    while (eventsFired < count)
+	interrupt->OneTick();
+    seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%d events in %.3f seconds (%d pending): %.0f events/sec\n",
+		count, seconds, EventTestDepth,
+		(seconds > 0) ? count / seconds : 0.0);
+}
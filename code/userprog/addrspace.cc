@@ -78,6 +78,8 @@ AddrSpace::AddrSpace(OpenFile *executable)
 						// to leave room for the stack
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    asid = currentThread->getTid();
+    numTLBMisses = 0;
     
     //ASSERT(numPages <= NumPhysPages);		// check we're not trying
 						// to run anything too big --
@@ -182,7 +184,12 @@ AddrSpace::~AddrSpace()
 */
 	for( int i = 0 ; i < NumPhysPages; i ++)
 	{
-		if( machine->invertedList[i].tid == currentThread->getTid() ) machine->invertedList[i].used = 0 ;
+		if( machine->invertedList[i].used && machine->invertedList[i].tid == asid )
+		{
+			machine->invertedList[i].used = 0 ;
+			machine->FlushTLBFrame(i) ;	// the tid, and so the asid,
+							// may be reused
+		}
 	}
 	printf("pageTime: %d\n", PageTime) ;
     for( int i = 0 ; i < NumPhysPages ; i ++ )
@@ -240,11 +247,13 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	which TLB entries are ours.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     //machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->SetASID(asid);
 }
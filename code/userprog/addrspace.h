@@ -37,6 +37,10 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    int asid;				// Tags its TLB entries; the tid of
+					// the thread that created it, which
+					// also owns its frames in invertedList
+    int numTLBMisses;			// TLB misses taken while running it
 };
 
 #endif // ADDRSPACE_H
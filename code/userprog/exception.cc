@@ -49,7 +49,7 @@
 //----------------------------------------------------------------------
 
 extern int tlbAccess, badAddress ;
-int turn = 0 ;
+
 int PageTime = 0 ;
 
 void
@@ -66,12 +66,16 @@ ExceptionHandler(ExceptionType which)
 	else if ((which == SyscallException) && (type == SC_Exit)) {
 		DEBUG('a', "Finish, initiated by user program.\n");
 		printf("System call implement by Yang: exit\n") ;
+		printf("Thread %d: %d TLB misses\n", currentThread->getTid(), 
+			currentThread->space->numTLBMisses) ;
    		currentThread->Finish();
     }   
     //tlb miss 
     else if (which == TLBMissException)
     {
     	tlbAccess ++ ;
+    	stats->numTLBMisses ++ ;
+    	currentThread->space->numTLBMisses ++ ;
 		unsigned int VAddr = machine->registers[BadVAddrReg] ;
     	unsigned int vpn = (unsigned) VAddr / PageSize ;
     	unsigned int offset = (unsigned) VAddr % PageSize ;
@@ -103,39 +107,10 @@ ExceptionHandler(ExceptionType which)
 		}
 		//if(tlbAccess%100000 < 5) printf("TLBAccess: %d, VPN: %d, %d, %d\n", tlbAccess, vpn, badAddress, VAddr ) ;
 		
-/*		
-		//1. ת 
-		machine->tlb[turn] = *entry ;
-		printf("TLBIndex: %d\n", turn) ;
-		turn = (turn + 1) % TLBSize ;
-*/		
-		//2. LRU
-		int index = 0, min = 1000000000 ;
-		for(int i = 0; i < TLBSize; i ++)
-		{
-			if( (machine->tlb[i]).time <= min ) 
-			{
-				min = (machine->tlb[i]).time ;
-				index = i ;
-			}
-		}
-		machine->tlb[index] = entry ;
-		//printf("tlb: %d, valid: %d\n", index, entry.valid) ;
-		//printf("TLBIndex: %d\n", index) ;		
-/*
-		//2. LFU
-		int index = 0, min = 10000000 ;
-		for(int i = 0; i < TLBSize; i ++)
-		{
-			if( (machine->tlb[i]).freq <= min ) 
-			{
-				min = (machine->tlb[i]).freq ;
-				index = i ;
-			}
-		}
-		machine->tlb[index] = *entry ;
-		printf("TLBIndex: %d\n", index) ;
-*/
+		// the TLB picks the slot: a free one of the set vpn maps to if there
+		// is one, otherwise the one its replacement policy chooses (see
+		// Machine::ConfigureTLB)
+		machine->LoadTLB(machine->TLBVictim(vpn), &entry) ;
 	}
 	//page miss 
     else if (which == PageFaultException)
@@ -159,9 +134,8 @@ ExceptionHandler(ExceptionType which)
     		int cannot = 0 ;
 			if( (machine->invertedList[i]).lastTime < min )
     		{
-    			for(int j = 0 ; j < 4 ; j ++ )
-					if( (machine->tlb[j]).virtualPage == (machine->invertedList[i]).vpn && 
-						currentThread->getTid() == (machine->invertedList[i]).tid)
+    			for(int j = 0 ; j < machine->tlbSize ; j ++ )
+					if( (machine->tlb[j]).valid && (machine->tlb[j]).physicalPage == i )
 							cannot = 1 ;
 				if( cannot == 1 ) continue ;
 				min = (machine->invertedList[i]).lastTime ;
@@ -174,14 +148,16 @@ ExceptionHandler(ExceptionType which)
 		{
 			int tid = (machine->invertedList[find]).tid ;
 			int ovpn = (machine->invertedList[find]).vpn ;
-			if(freeTid[tid] == 0)
+			machine->FlushTLBFrame(find) ;
+			Thread * thread = threadTable->Lookup(tid) ;
+			if(thread != NULL)
 			{
-				Thread * thread = Tpool[tid] ;
 				bcopy(&machine->mainMemory[find*PageSize], &thread->space->swap[ovpn*PageSize], PageSize) ;
 			}
 		}
 		
 		bcopy(&currentThread->space->swap[vpn*PageSize], &machine->mainMemory[find*PageSize], PageSize) ;
+		machine->InvalidateDecodedPage(find) ;
 		
 		(machine->invertedList[find]).used = TRUE ;
 		(machine->invertedList[find]).tid = currentThread->getTid() ;
@@ -195,6 +171,7 @@ ExceptionHandler(ExceptionType which)
 		(machine->invertedList[find]).entry.time = machine->TLBtime;
 		(machine->invertedList[find]).entry.physicalPage = find ;  
 		(machine->invertedList[find]).entry.virtualPage = vpn ;
+		(machine->invertedList[find]).entry.asid = currentThread->space->asid ;
 	}
 	else {
 		printf("Unexpected user mode exception %d %d\n", which, type);
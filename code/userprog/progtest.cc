@@ -24,10 +24,6 @@ void StartProcess(char *filename) ;
 
 void myStartProcess(int arg)
 {
-	if (threadToBeDestroyed != NULL) {
-        delete threadToBeDestroyed;
-		threadToBeDestroyed = NULL;
-    }
 	if( arg == 1 ) 
 	{
     	StartProcess("../test/sort") ;
@@ -35,10 +31,6 @@ void myStartProcess(int arg)
     if( arg == 0 )
     {
     	currentThread->Yield() ;
-		if ( threadToBeDestroyed != NULL) {
-        delete threadToBeDestroyed;
-		threadToBeDestroyed = NULL;
-    }
 	}
     
 }
@@ -60,6 +52,7 @@ StartProcess(char *filename)
     }
     space = new AddrSpace(executable);    
     currentThread->space = space;
+    currentThread->LoadUserState();	// take over the machine's registers
 
     delete executable;			// close file
 